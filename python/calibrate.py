@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+import argparse
+import time
+
+import serial
+
+from frames import FrameReader, FRAME_TYPE_LOG
+from log_decoder import load_formats, decode_record
+from telemetry_stream import make_frame
+
+#
+# Runs the sensor nonlinearity calibration (src/calibration.c): the wheel spins
+# at constant tension for a few turns, the device fits the AS5600 error and
+# saves the correction table to flash. The wheel has to be free to spin.
+# With --zero the wheel is held at its reference mark instead and that becomes angle 0.
+#
+
+FRAME_TYPE_CALIBRATE = 4
+
+TIMEOUT = 40.0      # s, longer than spin up and CALIBRATION_TIMEOUT_MS
+
+
+def calibrate(port: str, command: int) -> bool:
+    formats = load_formats()
+    reader = FrameReader()
+    with serial.Serial(port, 115200, timeout=0.1) as s:
+        s.write(make_frame(FRAME_TYPE_CALIBRATE, bytes([command])))
+        started_at = time.time()
+        while time.time() < started_at + TIMEOUT:
+            for item in reader.feed(s.read(1024)):
+                if isinstance(item, str) or item[0] != FRAME_TYPE_LOG:
+                    continue
+                line = decode_record(formats, item[1])
+                if "sensor" not in line.lower():
+                    continue
+                print(line)
+                if "calibration failed" in line:
+                    return False
+                if "calibration saved" in line:
+                    return True
+    print("Timed out")
+    return False
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Editing wheel sensor calibration")
+    parser.add_argument("--port", default="/dev/ttyACM0")
+    parser.add_argument("--clear", action="store_true", help="drop the saved table and use the raw sensor angle")
+    parser.add_argument("--zero", action="store_true", help="set angle 0 at the current wheel position")
+    args = parser.parse_args()
+
+    exit(0 if calibrate(args.port, 2 if args.zero else (0 if args.clear else 1)) else 1)
@@ -0,0 +1,44 @@
+import binascii
+from typing import Iterator, Tuple, Union
+
+#
+# Reader for binary frames sent by the firmware over CDC (see src/frame.h):
+#   [0xA5][type][len][payload][crc16 lo][crc16 hi]
+# Bytes that are not part of a valid frame are returned as text.
+#
+
+FRAME_SYNC = 0xA5
+FRAME_TYPE_LOG = 1
+
+
+class FrameReader:
+    def __init__(self) -> None:
+        self._buffer = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data: bytes) -> Iterator[Union[Tuple[int, bytes], str]]:
+        self._buffer += data
+        while len(self._buffer) > 0:
+            sync = self._buffer.find(FRAME_SYNC)
+            if sync != 0:
+                text = self._buffer if sync < 0 else self._buffer[:sync]
+                del self._buffer[:len(text)]
+                yield text.decode("utf-8", errors="replace")
+                continue
+
+            if len(self._buffer) < 3:
+                return
+            frame_type = self._buffer[1]
+            length = self._buffer[2]
+            if len(self._buffer) < 5 + length:
+                return
+
+            crc = self._buffer[3 + length] | self._buffer[4 + length] << 8
+            if binascii.crc_hqx(bytes(self._buffer[1:3 + length]), 0xFFFF) != crc:
+                self.crc_errors += 1
+                del self._buffer[:1]
+                continue
+
+            payload = bytes(self._buffer[3:3 + length])
+            del self._buffer[:5 + length]
+            yield frame_type, payload
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+import struct
+import sys
+from typing import Dict
+
+from profiles_bin import pack_profile, unpack_profile, PROFILE_SIZE
+
+#
+# Configuration and telemetry over HID feature reports (see tud_hid_get_report_cb in src/main.c)
+#
+
+USBD_VID = 0x2E8A
+USBD_PID = 0xC091
+
+REPORT_ID_CONFIG = 7
+REPORT_ID_PROFILE = 8
+REPORT_ID_TELEMETRY = 9
+
+TELEMETRY_FORMAT = "<IIHhffffffIBBfBIIIII"
+TELEMETRY_FIELDS = [
+    "time_us", "cycle", "raw_angle", "angle", "velocity", "error",
+    "p", "i", "d", "tension", "overrun_millis", "selected_profile", "buttons_state", "current",
+    "sensor_status", "sensor_i2c_errors", "sensor_magnet_missing", "sensor_magnet_weak", "sensor_magnet_strong",
+    "sensor_coasts"
+]
+
+
+class EditingWheelHID:
+    def __init__(self, vid: int = USBD_VID, pid: int = USBD_PID) -> None:
+        import hid
+        self._device = hid.device()
+        self._device.open(vid, pid)
+
+    def close(self) -> None:
+        self._device.close()
+
+    def select_profile(self, profile_no: int, cursor: int = 0) -> None:
+        self._device.send_feature_report([REPORT_ID_CONFIG, profile_no, cursor])
+
+    def get_config(self) -> Dict:
+        data = self._device.get_feature_report(REPORT_ID_CONFIG, 3)
+        return {"selected_profile": data[1], "cursor": data[2]}
+
+    def get_profile(self, profile_no: int) -> Dict:
+        config = self.get_config()
+        self.select_profile(config["selected_profile"], profile_no)
+        data = bytes(self._device.get_feature_report(REPORT_ID_PROFILE, 2 + PROFILE_SIZE))
+        return unpack_profile(data[2:2 + PROFILE_SIZE])
+
+    def set_profile(self, profile_no: int, profile: Dict) -> None:
+        self._device.send_feature_report(bytes([REPORT_ID_PROFILE, profile_no]) + pack_profile(profile))
+
+    def get_telemetry(self) -> Dict:
+        size = struct.calcsize(TELEMETRY_FORMAT)
+        data = bytes(self._device.get_feature_report(REPORT_ID_TELEMETRY, 1 + size))
+        return dict(zip(TELEMETRY_FIELDS, struct.unpack(TELEMETRY_FORMAT, data[1:1 + size])))
+
+
+if __name__ == '__main__':
+    args = sys.argv
+    wheel = EditingWheelHID()
+    try:
+        if len(args) > 2 and args[1] == "select":
+            wheel.select_profile(int(args[2]) - 1)
+        elif len(args) > 2 and args[1] == "profile":
+            print(wheel.get_profile(int(args[2]) - 1))
+        else:
+            print(wheel.get_telemetry())
+    finally:
+        wheel.close()
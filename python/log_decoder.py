@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+import os
+import re
+import struct
+import sys
+from typing import List
+
+import serial
+
+from frames import FrameReader, FRAME_TYPE_LOG
+
+#
+# Decodes binary log records (see src/log.h) sent over the CDC serial port.
+# Message formats are read from src/log_messages.h so they always match the firmware.
+#
+
+LOG_MESSAGES_PATH = os.path.join(os.path.dirname(__file__), "..", "src", "log_messages.h")
+LOG_RECORD_HEADER = "<IHBB"
+LOG_RECORD_HEADER_SIZE = struct.calcsize(LOG_RECORD_HEADER)
+
+
+def load_formats(path: str = LOG_MESSAGES_PATH) -> List[str]:
+    with open(path) as f:
+        return [m.group(2) for m in re.finditer(r'^LOG_MESSAGE\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', f.read(), re.MULTILINE)]
+
+
+def decode_record(formats: List[str], payload: bytes) -> str:
+    time_us, message_id, core, arg_count = struct.unpack(LOG_RECORD_HEADER, payload[:LOG_RECORD_HEADER_SIZE])
+    raw_args = struct.unpack(f"<{arg_count}I", payload[LOG_RECORD_HEADER_SIZE:LOG_RECORD_HEADER_SIZE + arg_count * 4])
+
+    if message_id >= len(formats):
+        return f"{time_us / 1000000:10.6f} [{core}] <unknown message {message_id}> {list(raw_args)}"
+
+    fmt = formats[message_id]
+    conversions = re.findall(r"%[-+ 0#]*\d*(?:\.\d+)?([a-zA-Z])", fmt)
+    args = []
+    for conversion, raw in zip(conversions, raw_args):
+        if conversion in "fFeEgG":
+            args.append(struct.unpack("<f", struct.pack("<I", raw))[0])
+        elif conversion in "diu" and raw >= 0x80000000:
+            args.append(raw - 0x100000000)
+        else:
+            args.append(raw)
+    try:
+        text = fmt % tuple(args)
+    except TypeError:
+        text = f"{fmt} {list(raw_args)}"
+    return f"{time_us / 1000000:10.6f} [{core}] {text}"
+
+
+if __name__ == '__main__':
+    args = sys.argv
+    port = args[1] if len(args) > 1 else "/dev/ttyACM0"
+
+    formats = load_formats()
+    reader = FrameReader()
+    with serial.Serial(port, 115200, timeout=0.1) as s:
+        while True:
+            for item in reader.feed(s.read(1024)):
+                if isinstance(item, str):
+                    print(item, end="")
+                elif item[0] == FRAME_TYPE_LOG:
+                    print(decode_record(formats, item[1]))
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+import json
+import os
+import struct
+import sys
+import zlib
+from typing import List, Dict
+
+#
+# PROFILES.BIN image as read and written by the firmware (see src/profile.h).
+# Keep PROFILE_FORMAT and PROFILES_BIN_VERSION in sync with profile_t.
+#
+
+PROFILES_BIN_MAGIC = 0x42505745  # "EWPB"
+PROFILES_BIN_VERSION = 10
+PROFILE_COUNT = 9
+
+HEADER_FORMAT = "<IHHHHI"
+HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+KEY_ACTIONS = ["wheel_main", "wheel_alt"]
+PROFILE_KEY_COUNT = 16  # "keys" - one action per key across all Neokey boards
+
+PROFILE_GESTURE_COUNT = 8
+GESTURE_TYPES = {"double_tap": 1, "hold": 2, "chord": 3, "wheel_alt": 4}
+GESTURE_FORMAT = "BBBx" + "BBh"
+
+PROFILE_EFFECT_COUNT = 4
+EFFECT_TYPES = {"end_stops": 1, "spring": 2, "friction": 3, "barrier": 4}
+EFFECT_FORMAT = "Bxhhh"
+
+# Plain fields after the effects, in profile_t order
+TAIL_FIELDS = [
+    ("pwm_frequency", "H"),
+    ("sensor_filter", "B"),
+    ("sensor_fast_threshold", "B"),
+    ("sensor_hysteresis", "B"),
+    ("sensor_oversample", "B"),
+    ("flywheel_inertia", "H"),
+    ("flywheel_friction", "H"),
+    ("accel_gain", "H"),
+    ("accel_low", "H"),
+    ("accel_high", "H"),
+    ("accel_curve", "H"),
+]
+
+PROFILE_FORMAT = ("<IIfffBB" + "BBh" * (len(KEY_ACTIONS) + PROFILE_KEY_COUNT) + "HH" + GESTURE_FORMAT * PROFILE_GESTURE_COUNT
+                  + EFFECT_FORMAT * PROFILE_EFFECT_COUNT + "".join(f for _, f in TAIL_FIELDS))
+PROFILE_SIZE = struct.calcsize(PROFILE_FORMAT)
+
+DEFAULT_PROFILE = {
+    "direction": 1,
+    "dividers": 16,
+    "expo": 0.0,
+    "gain": 1.0,
+    "dead_band": 0.4,
+    "fullres": 0,
+    "debounce": 0,
+    "long_press": 0,
+    **{field: 0 for field, _ in TAIL_FIELDS},
+}
+
+
+def pack_key_action(action: int) -> List[int]:
+    value = action & 0xffff
+    return [(action >> 24) & 0xff, (action >> 16) & 0xff, value - 0x10000 if value >= 0x8000 else value]
+
+
+def unpack_key_action(key_type: int, sub_type: int, value: int) -> int:
+    return key_type << 24 | sub_type << 16 | (value & 0xffff)
+
+
+def pack_gesture(gesture: Dict) -> List[int]:
+    return [GESTURE_TYPES[gesture["type"]], gesture["key_a"], gesture.get("key_b", 0)] + pack_key_action(gesture.get("action", 0))
+
+
+def unpack_gesture(values) -> Dict:
+    types = {v: k for k, v in GESTURE_TYPES.items()}
+    return {"type": types[values[0]], "key_a": values[1], "key_b": values[2], "action": unpack_key_action(*values[3:6])}
+
+
+def pack_effect(effect: Dict) -> List[int]:
+    return [EFFECT_TYPES[effect["type"]], effect.get("start", 0), effect.get("end", 0), effect["strength"]]
+
+
+def unpack_effect(values) -> Dict:
+    types = {v: k for k, v in EFFECT_TYPES.items()}
+    return {"type": types[values[0]], "start": values[1], "end": values[2], "strength": values[3]}
+
+
+def pack_profile(profile: Dict) -> bytes:
+    p = dict(DEFAULT_PROFILE)
+    p.update(profile)
+    values = [
+        p["direction"], p["dividers"],
+        p["expo"], p["gain"], p["dead_band"],
+        p["fullres"], 0
+    ]
+    for key_action in KEY_ACTIONS:
+        values += pack_key_action(p.get(key_action, 0))
+    keys = list(p.get("keys", []))
+    if len(keys) > PROFILE_KEY_COUNT:
+        raise ValueError(f"Expected at most {PROFILE_KEY_COUNT} keys, got {len(keys)}")
+    for key_action in keys + [0] * (PROFILE_KEY_COUNT - len(keys)):
+        values += pack_key_action(key_action)
+    values += [p["debounce"], p["long_press"]]
+    gestures = list(p.get("gestures", []))
+    if len(gestures) > PROFILE_GESTURE_COUNT:
+        raise ValueError(f"Expected at most {PROFILE_GESTURE_COUNT} gestures, got {len(gestures)}")
+    for gesture in gestures:
+        values += pack_gesture(gesture)
+    values += [0] * 6 * (PROFILE_GESTURE_COUNT - len(gestures))
+    effects = list(p.get("effects", []))
+    if len(effects) > PROFILE_EFFECT_COUNT:
+        raise ValueError(f"Expected at most {PROFILE_EFFECT_COUNT} effects, got {len(effects)}")
+    for effect in effects:
+        values += pack_effect(effect)
+    values += [0] * 4 * (PROFILE_EFFECT_COUNT - len(effects))
+    values += [p[field] for field, _ in TAIL_FIELDS]
+    return struct.pack(PROFILE_FORMAT, *values)
+
+
+def unpack_profile(data: bytes) -> Dict:
+    values = struct.unpack(PROFILE_FORMAT, data)
+    profile = {
+        "direction": values[0],
+        "dividers": values[1],
+        "expo": round(values[2], 3),
+        "gain": round(values[3], 3),
+        "dead_band": round(values[4], 3),
+        "fullres": values[5],
+    }
+    key_actions = [unpack_key_action(*values[i: i + 3]) for i in range(7, 7 + (len(KEY_ACTIONS) + PROFILE_KEY_COUNT) * 3, 3)]
+    for key_action, value in zip(KEY_ACTIONS, key_actions):
+        profile[key_action] = value
+    profile["keys"] = key_actions[len(KEY_ACTIONS):]
+    i = 7 + (len(KEY_ACTIONS) + PROFILE_KEY_COUNT) * 3
+    profile["debounce"], profile["long_press"] = values[i:i + 2]
+    gesture_values = values[i + 2:i + 2 + PROFILE_GESTURE_COUNT * 6]
+    profile["gestures"] = [
+        unpack_gesture(gesture_values[g * 6:(g + 1) * 6])
+        for g in range(PROFILE_GESTURE_COUNT) if gesture_values[g * 6] != 0
+    ]
+    effect_values = values[i + 2 + PROFILE_GESTURE_COUNT * 6:-len(TAIL_FIELDS)]
+    profile["effects"] = [
+        unpack_effect(effect_values[e * 4:(e + 1) * 4])
+        for e in range(PROFILE_EFFECT_COUNT) if effect_values[e * 4] != 0
+    ]
+    for (field, _), value in zip(TAIL_FIELDS, values[-len(TAIL_FIELDS):]):
+        profile[field] = value
+    return profile
+
+
+def build_image(profiles: List[Dict]) -> bytes:
+    if len(profiles) != PROFILE_COUNT:
+        raise ValueError(f"Expected {PROFILE_COUNT} profiles, got {len(profiles)}")
+
+    data = b"".join(pack_profile(p) for p in profiles)
+    header = struct.pack(
+        HEADER_FORMAT,
+        PROFILES_BIN_MAGIC, PROFILES_BIN_VERSION,
+        HEADER_SIZE, PROFILE_SIZE, PROFILE_COUNT,
+        zlib.crc32(data))
+    return header + data
+
+
+def parse_image(image: bytes) -> List[Dict]:
+    magic, version, header_size, profile_size, profile_count, crc = struct.unpack(HEADER_FORMAT, image[:HEADER_SIZE])
+    if magic != PROFILES_BIN_MAGIC:
+        raise ValueError("Not a PROFILES.BIN image")
+    if version != PROFILES_BIN_VERSION or profile_size != PROFILE_SIZE:
+        raise ValueError(f"Unsupported PROFILES.BIN version {version} (profile size {profile_size})")
+
+    data = image[header_size:header_size + profile_count * profile_size]
+    if zlib.crc32(data) != crc:
+        raise ValueError("PROFILES.BIN CRC mismatch")
+
+    return [unpack_profile(data[i * profile_size:(i + 1) * profile_size]) for i in range(profile_count)]
+
+
+def write_image(image: bytes, path: str) -> None:
+    # Rewrite existing file in place so the host keeps the same clusters
+    # and the firmware receives the whole image in one transfer.
+    mode = "r+b" if os.path.exists(path) else "wb"
+    with open(path, mode) as f:
+        f.write(image)
+        f.truncate()
+        f.flush()
+        os.fsync(f.fileno())
+
+
+if __name__ == '__main__':
+    args = sys.argv
+    if len(args) < 3 or args[1] not in ["build", "dump"]:
+        print(f"Usage: {args[0]} build <profiles.json> <PROFILES.BIN>")
+        print(f"       {args[0]} dump <PROFILES.BIN>")
+        sys.exit(1)
+
+    if args[1] == "build":
+        with open(args[2]) as f:
+            profiles = json.load(f)
+        image = build_image(profiles)
+        write_image(image, args[3])
+        print(f"Written {len(image)} bytes to {args[3]}")
+    else:
+        with open(args[2], "rb") as f:
+            profiles = parse_image(f.read())
+        print(json.dumps(profiles, indent=2))
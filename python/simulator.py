@@ -0,0 +1,547 @@
+#!/usr/bin/env python3
+import argparse
+import collections
+import math
+import os
+import re
+from dataclasses import dataclass, replace
+from typing import Dict, List, Optional
+
+#
+# Host simulator of the wheel: motor electrical and mechanical model, the AS5600
+# sample delay, the detent position loop of run_cycle() (src/core1_loop.c,
+# src/pid.c) with the latency compensation of src/feedforward.c, the optional
+# current loop of src/current.c and the H-bridge decay modes of motor_output()
+# (src/motor.h), switched at the PWM carrier. Loop constants are read from the
+# firmware headers so the simulation always matches the build.
+#
+
+SRC_PATH = os.path.join(os.path.dirname(__file__), "..", "src")
+
+CONTROL_PERIOD = 0.010      # s, core1 cycle
+PWM_FREQUENCY = 25000       # Hz, default carrier
+STEP = 5e-6                 # s, integration step
+I2C_READ_TIME = 135e-6      # s, AS5600 register write and 3 byte read at 400 kHz
+
+
+def load_defines(name: str) -> Dict[str, float]:
+    with open(os.path.join(SRC_PATH, name)) as f:
+        return {m.group(1): float(m.group(2))
+                for m in re.finditer(r"^#define\s+(\w+)\s+\(?([-+]?\d+(?:\.\d*)?)\)?\s*(?://.*)?$", f.read(), re.MULTILINE)}
+
+
+CURRENT = load_defines("current.h")
+CURRENT_MA_PER_COUNT = 3300.0 * 1000.0 / 4096.0 / CURRENT["CURRENT_SHUNT_MILLIOHM"] / CURRENT["CURRENT_SENSE_GAIN"]
+FEEDFORWARD = load_defines("feedforward.h")
+SENSOR = load_defines("sensor.h")
+MOTOR = load_defines("motor.h")
+FLYWHEEL = load_defines("flywheel.h")
+
+DECAY_MODES = ["slow", "fast", "auto"]
+
+
+@dataclass
+class Motor:
+    resistance: float = 8.0     # ohm
+    inductance: float = 0.001   # H
+    kt: float = 0.01            # Nm/A, same as back-EMF constant in V s/rad
+    inertia: float = 2e-5       # kg m^2, wheel and rotor
+    viscous: float = 2e-5       # Nm s/rad
+    supply: float = 5.0         # V
+
+
+@dataclass
+class Profile:
+    dividers: int = 16
+    expo: float = 0.9
+    gain_factor: float = 1.0
+    dead_band: float = 0.4
+    sensor_filter: int = 0      # AS5600 slow filter, 16x to 2x
+
+
+def sensor_delay(profile: Profile) -> float:
+    return SENSOR["AS5600_FILTER_DELAY_US"] / 1e6 / (1 << profile.sensor_filter)
+
+
+def angle_difference(a1: float, a2: float) -> float:
+    diff = a1 - a2
+    if diff >= 180.0:
+        return diff - 360.0
+    if diff <= -180.0:
+        return diff + 360.0
+    return diff
+
+
+def select_decay(tension: float, velocity: float) -> str:
+    # motor_decay() of core1_loop.c
+    if abs(tension) < MOTOR["MOTOR_COAST_TENSION"]:
+        return "coast"
+    if (tension > 0) == (velocity > 0) and abs(tension) < abs(velocity) * MOTOR["MOTOR_BACK_EMF"]:
+        return "fast"
+    return "slow"
+
+
+def apply_expo(value: float, expo: float) -> float:
+    if value >= 0.0:
+        return value * value * expo + value * (1.0 - expo)
+    return -value * value * expo + value * (1.0 - expo)
+
+
+class FeedForward:
+    # Observer, prediction and feed-forward terms of feedforward.c
+    def __init__(self) -> None:
+        self.tracking = False
+        self.position = 0.0
+        self.velocity = 0.0
+        self.acceleration = 0.0
+        self.last_sample = 0.0
+
+    def sample(self, angle: float, sample_time: float) -> None:
+        dt = sample_time - self.last_sample
+        if not self.tracking or dt <= 0 or dt > FEEDFORWARD["FEEDFORWARD_MAX_GAP_US"] / 1e6:
+            self.tracking = True
+            self.position, self.velocity, self.acceleration = angle, 0.0, 0.0
+            self.last_sample = sample_time
+            return
+        predicted = (self.position + self.velocity * dt) % 360.0
+        residual = angle_difference(angle, predicted)
+        last_velocity = self.velocity
+        self.position = (predicted + FEEDFORWARD["FEEDFORWARD_ALPHA"] * residual) % 360.0
+        self.velocity += FEEDFORWARD["FEEDFORWARD_BETA"] * residual / dt
+        self.acceleration += ((self.velocity - last_velocity) / dt - self.acceleration) * FEEDFORWARD["FEEDFORWARD_ACCEL_FILTER"]
+        self.last_sample = sample_time
+
+    def predict(self, now: float) -> float:
+        ahead = now - self.last_sample + FEEDFORWARD["FEEDFORWARD_LOOKAHEAD_US"] / 1e6
+        return (self.position + self.velocity * ahead) % 360.0
+
+    def tension(self) -> float:
+        friction = max(-1.0, min(1.0, self.velocity / FEEDFORWARD["FEEDFORWARD_FRICTION_VELOCITY"]))
+        drag = friction * FEEDFORWARD["FEEDFORWARD_FRICTION"] + self.velocity * FEEDFORWARD["FEEDFORWARD_VISCOUS"]
+        drag_max = abs(self.velocity) * MOTOR["MOTOR_BACK_EMF"]
+        return max(-drag_max, min(drag_max, drag)) + self.acceleration * FEEDFORWARD["FEEDFORWARD_INERTIA"]
+
+
+class PositionLoop:
+    # Detents of run_cycle() with the PID of pid.c as set up by set_profile()
+    def __init__(self, profile: Profile, feedforward: bool = False) -> None:
+        self.angle_of_retch = 360.0 / profile.dividers
+        self.expo = profile.expo
+        self.kp, self.ki, self.kd = 0.7, 0.0, 0.01
+        self.kg = profile.gain_factor * profile.dividers / 1.25
+        self.dead_band = profile.dead_band
+        self.i = 0.0
+        self.last_error: Optional[float] = None
+        self.last_angle: Optional[float] = None
+        self.velocity = 0.0
+        self.feedforward = FeedForward() if feedforward else None
+        self.sensor_delay = sensor_delay(profile)
+
+    def static_tension(self, angle: float) -> float:
+        # Proportional part only - the detent shape felt turning slowly
+        desired = math.floor(angle / self.angle_of_retch) * self.angle_of_retch + self.angle_of_retch / 2
+        error = apply_expo(angle_difference(desired, angle) / self.angle_of_retch, self.expo) * self.angle_of_retch
+        return max(-100.0, min(100.0, error * self.kp * self.kg))
+
+    def update(self, angle: float, sample_time: float, now: float) -> float:
+        # angle - degrees at the sensor resolution, seen at sample_time
+        if self.feedforward is not None:
+            self.feedforward.sample(angle, sample_time - self.sensor_delay)
+            self.velocity = self.feedforward.velocity
+            angle = self.feedforward.predict(now)
+        else:
+            if self.last_angle is not None:
+                self.velocity = angle_difference(angle, self.last_angle) / CONTROL_PERIOD
+            self.last_angle = angle
+        desired = math.floor(angle / self.angle_of_retch) * self.angle_of_retch + self.angle_of_retch / 2
+        error = angle_difference(desired, angle)
+        error = apply_expo(error / self.angle_of_retch, self.expo) * self.angle_of_retch
+        if abs(error) <= self.dead_band:
+            error = 0.0
+        if self.last_error is None:
+            self.last_error = error
+            return 0.0
+        if (self.last_error < 0 < error) or (self.last_error > 0 > error) or abs(error) < 0.1:
+            self.i = 0.0
+        else:
+            self.i += error * CONTROL_PERIOD
+        d = (error - self.last_error) / CONTROL_PERIOD
+        self.last_error = error
+        tension = (error * self.kp + self.i * self.ki + d * self.kd) * self.kg
+        if self.feedforward is not None and error != 0.0:
+            tension += self.feedforward.tension()
+        return max(-100.0, min(100.0, tension))
+
+
+class FlywheelLoop:
+    # Flywheel mode of run_cycle() with flywheel_update() of flywheel.c; the wheel
+    # speed comes from the feed-forward observer as with FEEDFORWARD on.
+    # push - also add feed-forward tension on top of the flywheel's drag
+    def __init__(self, profile: Profile, inertia_ms: int, friction: int, push: bool = False) -> None:
+        self.inertia = inertia_ms / 1000.0
+        self.friction = friction
+        self.step_angle = 360.0 / profile.dividers
+        self.observer = FeedForward()
+        self.push = push
+        self.sensor_delay = sensor_delay(profile)
+        self.velocity = 0.0             # wheel, degrees/s
+        self.flywheel_velocity = 0.0
+        self.position = 0.0
+        self.steps = 0
+        self.last_angle: Optional[float] = None
+        self.last_time = 0.0
+
+    def update(self, angle: float, sample_time: float, now: float) -> float:
+        self.observer.sample(angle, sample_time - self.sensor_delay)
+        self.velocity = self.observer.velocity
+        if self.last_angle is None:
+            self.last_angle, self.last_time = angle, now
+            return 0.0
+        dt = now - self.last_time
+        wheel_delta = angle_difference(angle, self.last_angle)
+        self.last_angle, self.last_time = angle, now
+
+        drag = 0.0
+        v = self.flywheel_velocity
+        same_direction = v == 0.0 or (self.velocity > 0.0) == (v > 0.0)
+        if not same_direction and abs(self.velocity) > FLYWHEEL["FLYWHEEL_STOP_VELOCITY"]:
+            v = 0.0
+        elif same_direction and abs(self.velocity) > abs(v):
+            slip = self.velocity - v
+            v += slip if dt >= self.inertia else slip * dt / self.inertia
+            drag = -slip * FLYWHEEL["FLYWHEEL_DRAG"]
+        else:
+            loss = (self.friction + abs(v) * FLYWHEEL["FLYWHEEL_VISCOUS"]) * dt
+            if abs(v) <= loss + FLYWHEEL["FLYWHEEL_MIN_VELOCITY"]:
+                v = 0.0
+            else:
+                v -= loss if v > 0.0 else -loss
+        self.flywheel_velocity = v
+
+        flywheel_delta = v * dt
+        self.position += wheel_delta if abs(wheel_delta) > abs(flywheel_delta) else flywheel_delta
+        steps = int(self.position / self.step_angle)
+        self.position -= steps * self.step_angle
+        self.steps += steps
+        if self.push:
+            drag += self.observer.tension()
+        return max(-100.0, min(100.0, drag))
+
+
+class CurrentLoop:
+    # PI of current.c, duty percent per mA
+    def __init__(self) -> None:
+        self.integral = 0.0
+
+    def update(self, target_ma: float, measured_ma: float) -> float:
+        error = target_ma - measured_ma
+        integral = self.integral + error * CURRENT["CURRENT_KI"]
+        duty = error * CURRENT["CURRENT_KP"] + integral
+        if -100.0 < duty < 100.0:
+            self.integral = integral
+        return max(-100.0, min(100.0, duty))
+
+
+class Simulator:
+    def __init__(self, motor: Motor, profile: Profile, current_loop: bool, feedforward: bool = False,
+                 decay: str = "slow") -> None:
+        self.motor = motor
+        self.decay_mode = decay
+        self.decay = "slow"       # bridge state this cycle
+        self.position_loop = PositionLoop(profile, feedforward)
+        self.current_loop = CurrentLoop() if current_loop else None
+        self.block_period = CURRENT["CURRENT_BLOCK_PERIODS"] / PWM_FREQUENCY
+        self.pwm_period = 1.0 / PWM_FREQUENCY
+        self.steps_per_period = round(self.pwm_period / STEP)
+        self.step_count = 0
+        self.time = 0.0
+        self.angle = 0.0            # degrees
+        self.velocity = 0.0         # degrees/s
+        self.current = 0.0          # A
+        self.duty = 0.0             # percent
+        self.target_ma = 0.0
+        self.tension = 0.0
+        # Angles seen by the sensor, oldest first, one per STEP
+        self.sensor_delay = sensor_delay(profile)
+        self.history = collections.deque(maxlen=int((self.sensor_delay + I2C_READ_TIME) / STEP) + 1)
+
+    def measured_ma(self, mean_current: float) -> float:
+        # ADC quantisation of the block mean
+        return round(mean_current * 1000.0 / CURRENT_MA_PER_COUNT) * CURRENT_MA_PER_COUNT
+
+    def winding(self, voltage: float, dt: float, emf: float) -> None:
+        m = self.motor
+        self.current += (voltage - m.resistance * self.current - emf) / m.inductance * dt
+
+    def bridge_off(self, dt: float, emf: float) -> None:
+        # Current returns to the supply through the body diodes until it is gone,
+        # then the winding is open (back-EMF stays under the supply)
+        if self.current == 0.0:
+            return
+        before = self.current
+        self.winding(-math.copysign(self.motor.supply, before), dt, emf)
+        if (self.current > 0) != (before > 0):
+            self.current = 0.0
+
+    def bridge_step(self, emf: float) -> None:
+        # One STEP of the H-bridge: on for the first duty of each carrier period,
+        # then the off-time of the decay mode
+        phase = (self.step_count % self.steps_per_period) * STEP
+        on = 0.0
+        if self.decay != "coast":
+            on = min(STEP, max(0.0, abs(self.duty) / 100.0 * self.pwm_period - phase))
+        if on > 0.0:
+            self.winding(math.copysign(self.motor.supply, self.duty), on, emf)
+        if STEP - on > 0.0:
+            if self.decay == "slow":
+                self.winding(0.0, STEP - on, emf)
+            else:
+                self.bridge_off(STEP - on, emf)
+        self.step_count += 1
+
+    def run(self, duration: float, hand_velocity: Optional[float] = None, target_ma: Optional[float] = None,
+            tension: Optional[float] = None) -> List[Dict]:
+        # hand_velocity - wheel turned by hand at this speed (degrees/s), otherwise free
+        # target_ma - fixed current target instead of the position loop (current loop only)
+        # tension - fixed tension instead of the position loop
+        m = self.motor
+        samples = []
+        next_control = self.time
+        next_block = self.time
+        block_sum, block_count = 0.0, 0
+        end = self.time + duration
+        if hand_velocity is not None:
+            self.velocity = hand_velocity
+        while self.time < end:
+            self.history.append(self.angle)
+            if self.time >= next_control:
+                next_control += CONTROL_PERIOD
+                if target_ma is None:
+                    # Read starts now and sees the filtered angle of sensor_delay ago; the
+                    # tension is set once the read is done
+                    delayed = self.history[-min(len(self.history), int(self.sensor_delay / STEP) + 1)]
+                    counts = int(delayed * 4096 / 360.0) % 4096
+                    self.tension = self.position_loop.update(counts * 360.0 / 4096, self.time, self.time + I2C_READ_TIME)
+                    if tension is not None:
+                        self.tension = tension
+                if self.decay_mode == "auto":
+                    self.decay = select_decay(self.tension, self.position_loop.velocity)
+                else:
+                    self.decay = self.decay_mode
+                if self.current_loop is None:
+                    self.duty = self.tension
+                else:
+                    self.target_ma = target_ma if target_ma is not None else self.tension * CURRENT["CURRENT_MAX_MA"] / 100.0
+            if self.current_loop is not None and self.time >= next_block:
+                next_block += self.block_period
+                if block_count:
+                    self.duty = self.current_loop.update(self.target_ma, self.measured_ma(block_sum / block_count))
+                block_sum, block_count = 0.0, 0
+
+            omega = math.radians(self.velocity)
+            self.bridge_step(m.kt * omega)
+            torque = m.kt * self.current
+            if hand_velocity is None:
+                self.velocity += math.degrees((torque - m.viscous * omega) / m.inertia) * STEP
+            self.angle = (self.angle + self.velocity * STEP) % 360.0
+            block_sum += self.current
+            block_count += 1
+            samples.append({"time": self.time, "angle": self.angle, "current_ma": self.current * 1000.0,
+                            "torque_mnm": torque * 1000.0, "duty": self.duty, "tension": self.tension})
+            self.time += STEP
+        return samples
+
+
+def current_step(motor: Motor, target_ma: float) -> Dict:
+    # Step response of the current loop on the mean current of each carrier
+    # period - what the torque follows; the carrier ripple is reported apart
+    sim = Simulator(motor, Profile(), current_loop=True)
+    samples = sim.run(0.005, hand_velocity=0.0, target_ma=target_ma)
+    n = sim.steps_per_period
+    periods = [{"time": samples[k]["time"], "current_ma": sum(s["current_ma"] for s in samples[k:k + n]) / n}
+               for k in range(0, len(samples) - n + 1, n)]
+    currents = [p["current_ma"] for p in periods]
+    rise_start = next(p["time"] for p in periods if p["current_ma"] >= 0.1 * target_ma)
+    rise_end = next(p["time"] for p in periods if p["current_ma"] >= 0.9 * target_ma)
+    settled = [s["current_ma"] for s in samples[-10 * n:]]
+    return {
+        "rise_us": (rise_end - rise_start) * 1e6,
+        "overshoot_pct": max(0.0, (max(currents) / target_ma - 1) * 100),
+        "final_ma": sum(currents[-10:]) / 10,
+        "ripple_ma": max(settled) - min(settled),
+    }
+
+
+def detent_torque(motor: Motor, profile: Profile, current_loop: bool, hand_velocity: float) -> Dict:
+    sim = Simulator(motor, profile, current_loop)
+    sim.run(0.1, hand_velocity=hand_velocity)
+    samples = sim.run(360.0 / profile.dividers * 4 / abs(hand_velocity), hand_velocity=hand_velocity)
+    torques = [s["torque_mnm"] for s in samples]
+    return {
+        "peak_mnm": max(abs(t) for t in torques),
+        "rms_mnm": math.sqrt(sum(t * t for t in torques) / len(torques)),
+    }
+
+
+def detent_shape(motor: Motor, profile: Profile, feedforward: bool, hand_velocity: float) -> Dict:
+    # Torque against angle folded into one detent, compared with the shape felt
+    # turning slowly: lag is the shift that matches it best, match the correlation
+    # in place (1 for the same shape at the same angles) and drag the mean torque
+    # against the hand.
+    sim = Simulator(motor, profile, False, feedforward)
+    sim.run(0.1, hand_velocity=hand_velocity)
+    samples = sim.run(360.0 / profile.dividers * 8 / abs(hand_velocity), hand_velocity=hand_velocity)
+
+    period = 360.0 / profile.dividers
+    bins = 180
+    sums, counts = [0.0] * bins, [0] * bins
+    for s in samples:
+        b = int((s["angle"] % period) / period * bins) % bins
+        sums[b] += s["torque_mnm"]
+        counts[b] += 1
+    shape = [sums[b] / counts[b] if counts[b] else 0.0 for b in range(bins)]
+    stall_mnm = motor.kt * motor.supply / motor.resistance * 1000.0
+    ideal = [sim.position_loop.static_tension((b + 0.5) / bins * period) / 100.0 * stall_mnm for b in range(bins)]
+
+    def correlation(shift: int) -> float:
+        a = [shape[(b + shift) % bins] for b in range(bins)]
+        ma, mi = sum(a) / bins, sum(ideal) / bins
+        cov = sum((x - ma) * (y - mi) for x, y in zip(a, ideal))
+        return cov / math.sqrt(sum((x - ma) ** 2 for x in a) * sum((y - mi) ** 2 for y in ideal))
+
+    shift = max(range(-bins // 2, bins // 2), key=correlation)
+    direction = 1.0 if hand_velocity > 0 else -1.0
+    return {
+        "lag_deg": shift * period / bins * direction,
+        "match": correlation(0),
+        "drag_mnm": -sum(s["torque_mnm"] for s in samples) / len(samples) * direction,
+    }
+
+
+def coast_down(motor: Motor, decay: str, velocity: float, duration: float) -> float:
+    # Wheel let go at velocity with no tension asked for: speed left after duration
+    sim = Simulator(motor, Profile(), False, False, decay)
+    sim.velocity = velocity
+    sim.run(duration, tension=0.0)
+    return sim.velocity
+
+
+def stop_time(motor: Motor, decay: str, velocity: float, tension: float) -> float:
+    # Free wheel at velocity braked by a fixed tension against it: ms to stand still,
+    # 1000 or more when it doesn't
+    sim = Simulator(motor, Profile(), False, False, decay)
+    sim.velocity = velocity
+    while sim.velocity * velocity > 0.0 and sim.time < 1.0:
+        sim.run(CONTROL_PERIOD / 10, tension=tension)
+    return sim.time * 1000.0
+
+
+def push_torque(motor: Motor, decay: str, velocity: float, tension: float) -> float:
+    # Mean torque of a fixed tension with the hand turning the wheel
+    sim = Simulator(motor, Profile(), False, False, decay)
+    sim.run(0.02, hand_velocity=velocity, tension=tension)
+    samples = sim.run(0.02, hand_velocity=velocity, tension=tension)
+    return sum(s["torque_mnm"] for s in samples) / len(samples)
+
+
+def flywheel_let_go(motor: Motor, push: bool, velocity: float) -> Dict:
+    # A 24 step flywheel profile spun up by hand, then let go: ms until the flywheel stops
+    # stepping (5000 or more when it doesn't) and the wheel's own speed by then
+    profile = Profile(dividers=24, sensor_filter=3)
+    sim = Simulator(motor, profile, False)
+    loop = FlywheelLoop(profile, 300, 360, push)
+    sim.position_loop = loop
+    sim.run(0.5, hand_velocity=velocity)
+    let_go = sim.time
+    while loop.flywheel_velocity != 0.0 and sim.time < let_go + 5.0:
+        sim.run(CONTROL_PERIOD)
+    return {"stop_ms": (sim.time - let_go) * 1000.0, "wheel": sim.velocity}
+
+
+CONDITIONS = {
+    "nominal": {},
+    "supply 4.5V": {"supply": 4.5},
+    "supply 5.5V": {"supply": 5.5},
+    "hot winding": {"resistance": 8.0 * 1.2},
+}
+
+
+SPIN_VELOCITIES = [90.0, 360.0, 720.0, 1440.0]
+
+
+def validate(velocity: float) -> None:
+    motor = Motor()
+    profile = Profile()
+
+    step = current_step(motor, CURRENT["CURRENT_MAX_MA"] / 2)
+    print(f"Current step to {CURRENT['CURRENT_MAX_MA'] / 2:.0f} mA: rise {step['rise_us']:.0f} us, "
+          f"overshoot {step['overshoot_pct']:.1f}%, settled at {step['final_ma']:.1f} mA, "
+          f"carrier ripple {step['ripple_ma']:.0f} mA")
+
+    print(f"\nDetent torque turning at {velocity:.0f} deg/s, {profile.dividers} detents")
+    print(f"{'condition':<14}{'duty rms':>10}{'duty peak':>11}{'current rms':>13}{'current peak':>14}  (mNm)")
+    results = {}
+    for name, changes in CONDITIONS.items():
+        conditioned = replace(motor, **changes)
+        duty = detent_torque(conditioned, profile, False, velocity)
+        current = detent_torque(conditioned, profile, True, velocity)
+        results[name] = (duty, current)
+        print(f"{name:<14}{duty['rms_mnm']:>10.2f}{duty['peak_mnm']:>11.2f}{current['rms_mnm']:>13.2f}{current['peak_mnm']:>14.2f}")
+
+    for mode, index in [("duty", 0), ("current", 1)]:
+        rms = [r[index]["rms_mnm"] for r in results.values()]
+        print(f"{mode} mode: detent torque varies {(max(rms) / min(rms) - 1) * 100:.1f}% across conditions")
+
+    print(f"\nDetent shape while spinning, {profile.dividers} detents, latency compensation off / on")
+    print(f"{'deg/s':>6}{'lag':>9}{'match':>8}{'drag':>8}  |{'lag':>8}{'match':>8}{'drag':>8}  (deg, 1.0 best, mNm)")
+    for spin in SPIN_VELOCITIES:
+        off = detent_shape(motor, profile, False, spin)
+        on = detent_shape(motor, profile, True, spin)
+        print(f"{spin:>6.0f}{off['lag_deg']:>9.2f}{off['match']:>8.3f}{off['drag_mnm']:>8.3f}  |"
+              f"{on['lag_deg']:>8.2f}{on['match']:>8.3f}{on['drag_mnm']:>8.3f}")
+
+    print(f"\nOutput stage decay, {' / '.join(DECAY_MODES)}")
+    let_go = [coast_down(motor, mode, 720.0, 0.3) for mode in DECAY_MODES]
+    print(f"let go at 720 deg/s, speed after 300 ms: " + " / ".join(f"{v:.0f}" for v in let_go) + " deg/s")
+    stops = [stop_time(motor, mode, 720.0, -20.0) for mode in DECAY_MODES]
+    print(f"tension -20 against 720 deg/s, stopped after: " + " / ".join(f"{t:.1f}" if t < 1000.0 else "-" for t in stops) + " ms")
+    stall_mnm = motor.kt * motor.supply / motor.resistance * 1000.0
+    for spin, push in [(360.0, 2.0), (1440.0, 2.0), (1440.0, 5.0)]:
+        torques = [push_torque(motor, mode, spin, push) for mode in DECAY_MODES]
+        print(f"tension {push:.0f} with the hand at {spin:.0f} deg/s: " + " / ".join(f"{t:.2f}" for t in torques)
+              + f" mNm, ideal {push / 100.0 * stall_mnm:.2f}")
+
+    print("\nFlywheel profile let go, feed-forward added on top / flywheel drag only")
+    for spin in [360.0, 720.0, 1440.0]:
+        runs = [flywheel_let_go(motor, push, spin) for push in [True, False]]
+        print(f"let go at {spin:.0f} deg/s: flywheel stopped after "
+              + " / ".join(f"{r['stop_ms']:.0f}" if r["stop_ms"] < 5000.0 else "-" for r in runs)
+              + " ms, wheel then at " + " / ".join(f"{r['wheel']:.0f}" for r in runs) + " deg/s")
+
+
+def plot(velocity: float, current_loop: bool, feedforward: bool, decay: str) -> None:
+    import matplotlib.pyplot as plt
+
+    sim = Simulator(Motor(), Profile(), current_loop, feedforward, decay)
+    samples = sim.run(360.0 / Profile().dividers * 4 / abs(velocity), hand_velocity=velocity)[::20]
+    fields = ["torque_mnm", "current_ma", "duty", "tension"]
+    fig, axes = plt.subplots(len(fields), 1, sharex=True)
+    for ax, field in zip(axes, fields):
+        ax.set_ylabel(field)
+        ax.plot([s["angle"] for s in samples], [s[field] for s in samples], ".", markersize=1)
+    axes[-1].set_xlabel("angle")
+    plt.show()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Editing wheel motor and control loop simulator")
+    parser.add_argument("--velocity", type=float, default=90.0, help="hand speed in degrees/s")
+    parser.add_argument("--plot", choices=["duty", "current"], help="plot a sweep through the detents")
+    parser.add_argument("--feedforward", action="store_true", help="plot with latency compensation")
+    parser.add_argument("--decay", choices=DECAY_MODES, default="slow", help="plot with this H-bridge decay")
+    args = parser.parse_args()
+
+    if args.plot:
+        plot(args.velocity, args.plot == "current", args.feedforward, args.decay)
+    else:
+        validate(args.velocity)
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+import argparse
+import binascii
+import collections
+import csv
+import struct
+import time
+
+import serial
+
+from frames import FrameReader, FRAME_SYNC, FRAME_TYPE_LOG
+from hid_config import TELEMETRY_FORMAT, TELEMETRY_FIELDS
+from log_decoder import load_formats, decode_record
+
+#
+# Reads the binary telemetry stream (one sample per control cycle) from the CDC serial port.
+# Samples can be recorded to CSV and/or plotted live.
+#
+
+FRAME_TYPE_TELEMETRY = 2
+FRAME_TYPE_STREAM = 3
+
+PLOT_FIELDS = ["angle", "velocity", "error", "p", "i", "d", "tension"]
+
+
+def make_frame(frame_type: int, payload: bytes) -> bytes:
+    body = bytes([frame_type, len(payload)]) + payload
+    crc = binascii.crc_hqx(body, 0xFFFF)
+    return bytes([FRAME_SYNC]) + body + bytes([crc & 0xff, crc >> 8])
+
+
+class TelemetryStream:
+    def __init__(self, port: str) -> None:
+        self._serial = serial.Serial(port, 115200, timeout=0.05)
+        self._reader = FrameReader()
+        self._formats = load_formats()
+        self.last_cycle = None
+        self.missed = 0
+
+    def start(self) -> None:
+        self._serial.write(make_frame(FRAME_TYPE_STREAM, bytes([1])))
+
+    def stop(self) -> None:
+        self._serial.write(make_frame(FRAME_TYPE_STREAM, bytes([0])))
+
+    def close(self) -> None:
+        self.stop()
+        self._serial.close()
+
+    def read(self):
+        for item in self._reader.feed(self._serial.read(4096)):
+            if isinstance(item, str):
+                print(item, end="")
+            elif item[0] == FRAME_TYPE_LOG:
+                print(decode_record(self._formats, item[1]))
+            elif item[0] == FRAME_TYPE_TELEMETRY:
+                sample = dict(zip(TELEMETRY_FIELDS, struct.unpack(TELEMETRY_FORMAT, item[1])))
+                if self.last_cycle is not None and sample["cycle"] != self.last_cycle + 1:
+                    self.missed += (sample["cycle"] - self.last_cycle - 1) & 0xffffffff
+                self.last_cycle = sample["cycle"]
+                yield sample
+
+
+def record(stream: TelemetryStream, filename: str, duration: float) -> None:
+    started_at = time.time()
+    count = 0
+    with open(filename, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=TELEMETRY_FIELDS)
+        writer.writeheader()
+        while duration == 0 or time.time() < started_at + duration:
+            for sample in stream.read():
+                writer.writerow(sample)
+                count += 1
+    print(f"Recorded {count} samples, missed {stream.missed}")
+
+
+def plot(stream: TelemetryStream, window: int) -> None:
+    import matplotlib.pyplot as plt
+    import matplotlib.animation as animation
+
+    history = {field: collections.deque(maxlen=window) for field in ["time_us"] + PLOT_FIELDS}
+
+    fig, axes = plt.subplots(len(PLOT_FIELDS), 1, sharex=True)
+    lines = {}
+    for ax, field in zip(axes, PLOT_FIELDS):
+        ax.set_ylabel(field)
+        lines[field], = ax.plot([], [])
+
+    def update(_):
+        for sample in stream.read():
+            for field in history:
+                history[field].append(sample[field])
+        if len(history["time_us"]) > 1:
+            t0 = history["time_us"][-1]
+            t = [(((ts - t0 + (1 << 31)) & 0xffffffff) - (1 << 31)) / 1000000 for ts in history["time_us"]]
+            for ax, field in zip(axes, PLOT_FIELDS):
+                lines[field].set_data(t, list(history[field]))
+                ax.relim()
+                ax.autoscale_view()
+        return list(lines.values())
+
+    _ = animation.FuncAnimation(fig, update, interval=50, cache_frame_data=False)
+    plt.show()
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description="Editing wheel telemetry stream")
+    parser.add_argument("--port", default="/dev/ttyACM0")
+    parser.add_argument("--record", help="CSV file to record samples to")
+    parser.add_argument("--duration", type=float, default=10, help="seconds to record, 0 for until interrupted")
+    parser.add_argument("--window", type=int, default=2000, help="samples shown when plotting")
+    args = parser.parse_args()
+
+    telemetry_stream = TelemetryStream(args.port)
+    telemetry_stream.start()
+    try:
+        if args.record:
+            record(telemetry_stream, args.record, args.duration)
+        else:
+            plot(telemetry_stream, args.window)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        telemetry_stream.close()
@@ -0,0 +1,50 @@
+#include <math.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "accel.h"
+
+static uint16_t gain_table[ACCEL_TABLE_SIZE];
+static bool enabled = false;
+static int32_t carry = 0;       // Q8 fraction of a detent not sent yet
+
+// Called by set_profile(), on core0 like accel_apply()
+void accel_configure(uint16_t gain, uint16_t low, uint16_t high, uint16_t curve) {
+    carry = 0;
+    enabled = gain > 100;
+    if (!enabled) { return; }
+
+    if (gain > ACCEL_MAX_GAIN) { gain = ACCEL_MAX_GAIN; }
+    if (high <= low) { high = low + 1; }
+    float exponent = (curve ? curve : ACCEL_DEFAULT_CURVE) / 10.0;
+    float extra = (gain - 100) / 100.0;
+
+    for (int i = 0; i < ACCEL_TABLE_SIZE; i++) {
+        float speed = i << ACCEL_TABLE_SHIFT;
+        float t = speed <= low ? 0.0 : (speed >= high ? 1.0 : (speed - low) / (float)(high - low));
+        gain_table[i] = (uint16_t)lroundf((1.0 + extra * powf(t, exponent)) * ACCEL_GAIN_ONE);
+    }
+}
+
+// Detents passed to the detents to send, at wheel velocity degrees/s
+int32_t accel_apply(int32_t detents, float velocity) {
+    if (!enabled || detents == 0) { return detents; }
+
+    uint32_t speed = (uint32_t)fabsf(velocity);
+    uint32_t index = speed >> ACCEL_TABLE_SHIFT;
+    uint32_t gain;
+    if (index >= ACCEL_TABLE_SIZE - 1) {
+        gain = gain_table[ACCEL_TABLE_SIZE - 1];
+    } else {
+        int32_t frac = speed & ((1 << ACCEL_TABLE_SHIFT) - 1);
+        int32_t a = gain_table[index];
+        int32_t b = gain_table[index + 1];
+        gain = a + (((b - a) * frac) >> ACCEL_TABLE_SHIFT);
+    }
+
+    // A turn back drops what was left over from the other way
+    if ((carry < 0) != (detents < 0)) { carry = 0; }
+    int32_t scaled = detents * (int32_t)gain + carry;
+    int32_t out = scaled / ACCEL_GAIN_ONE;
+    carry = scaled - out * ACCEL_GAIN_ONE;
+    return out;
+}
@@ -0,0 +1,25 @@
+#ifndef ACCEL_H__
+#define ACCEL_H__
+
+// Wheel acceleration (profile accel_gain above 100): detents sent to the host
+// are multiplied by a gain that rises with the wheel speed, like pointer
+// acceleration - slow turns step frame by frame, fast spins cover far more.
+//   accel_gain  - gain at and above accel_high, percent
+//   accel_low   - degrees/s, gain 1 below
+//   accel_high  - degrees/s, full gain above
+//   accel_curve - shape between the two, exponent x10: 10 linear, 20 square
+// The curve is built into a table on profile change; wheel_task() looks the
+// gain up in fixed point and carries the fraction over to the next detents.
+
+// Table step 1 << ACCEL_TABLE_SHIFT degrees/s, up to 2048 degrees/s
+#define ACCEL_TABLE_SHIFT 5
+#define ACCEL_TABLE_SIZE 65
+
+// Gains are Q8.8
+#define ACCEL_GAIN_SHIFT 8
+#define ACCEL_GAIN_ONE (1 << ACCEL_GAIN_SHIFT)
+
+#define ACCEL_MAX_GAIN 10000 // percent
+#define ACCEL_DEFAULT_CURVE 10
+
+#endif /* ACCEL_H__ */
@@ -0,0 +1,22 @@
+#ifndef BOOT_H__
+#define BOOT_H__
+
+// Startup runs as soon as the hardware answers instead of after fixed delays.
+// Every phase is logged with its time since reset (LOG_BOOT_PHASE); the target
+// is BOOT_PHASE_HAPTICS - first control cycle with a valid angle - within 200 ms.
+
+enum {
+    BOOT_PHASE_SCHEDULER = 0,       // board, USB and stdio initialised
+    BOOT_PHASE_I2C,
+    BOOT_PHASE_SENSOR,              // AS5600 answered
+    BOOT_PHASE_SENSOR_TIMEOUT,      // AS5600 didn't answer, started anyway
+    BOOT_PHASE_KEYPAD,              // Neokey boards initialised or left to recovery
+    BOOT_PHASE_CORE1,
+    BOOT_PHASE_HAPTICS,
+};
+
+// AS5600 is retried this often until it answers or the timeout passes
+#define BOOT_SENSOR_PROBE_PERIOD 5
+#define BOOT_SENSOR_PROBE_TIMEOUT 1000
+
+#endif /* BOOT_H__ */
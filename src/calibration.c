@@ -0,0 +1,241 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "calibration.h"
+#include "log.h"
+
+extern uint32_t crc32(const uint8_t* data, size_t len);
+extern void motor_park();
+extern void motor_resume();
+
+enum {
+    CALIBRATION_IDLE = 0,
+    CALIBRATION_SPIN_UP,
+    CALIBRATION_SAMPLING,
+};
+
+enum {
+    CALIBRATION_FAILED_SENSOR = 1,
+    CALIBRATION_FAILED_STALLED,
+    CALIBRATION_FAILED_REVOLUTIONS,
+};
+
+// No movement for this long while spinning is a stall
+#define CALIBRATION_STALL_MS 500
+
+static calibration_t calibration;
+
+// Measurement runs on core1 in place of the detent law
+static volatile bool zero_requested = false;
+static volatile bool start_requested = false;
+static volatile bool fit_requested = false;
+static volatile bool save_requested = false;
+static uint8_t state = CALIBRATION_IDLE;
+static uint32_t started_at_us;
+static uint32_t moved_at_us;
+static uint16_t last_raw;
+static int32_t unwrapped;
+
+static uint32_t sample_count;
+static uint32_t sample_time_us[CALIBRATION_MAX_SAMPLES];
+static int32_t sample_counts[CALIBRATION_MAX_SAMPLES];
+
+static uint32_t calibration_crc(const calibration_t* c) {
+    return crc32((const uint8_t*)c, offsetof(calibration_t, crc32));
+}
+
+// Reads the table saved in flash, without one the sensor is used as it is
+void calibration_load() {
+    const calibration_t* saved = (const calibration_t*)(XIP_BASE + CALIBRATION_FLASH_OFFSET);
+    if (saved->magic == CALIBRATION_MAGIC && saved->version == CALIBRATION_VERSION &&
+            saved->size == sizeof(calibration_t) && saved->crc32 == calibration_crc(saved)) {
+        memcpy(&calibration, saved, sizeof(calibration_t));
+        LOG(LOG_CALIBRATION_LOADED);
+    } else {
+        memset(&calibration, 0, sizeof(calibration_t));
+        calibration.zero = CALIBRATION_DEFAULT_ZERO;
+        LOG(LOG_CALIBRATION_MISSING);
+    }
+}
+
+// Raw AS5600 counts to corrected counts, interpolated between table entries
+static uint16_t calibration_correct(uint16_t raw) {
+    uint32_t index = raw >> CALIBRATION_LUT_SHIFT;
+    int32_t frac = raw & ((1 << CALIBRATION_LUT_SHIFT) - 1);
+    int32_t a = calibration.lut[index];
+    int32_t b = calibration.lut[(index + 1) % CALIBRATION_LUT_SIZE];
+    int32_t corrected = (int32_t)raw + a + (((b - a) * frac) >> CALIBRATION_LUT_SHIFT);
+    return corrected & 4095;
+}
+
+// Raw AS5600 counts to counts from the mechanical reference. Called by
+// read_angle() on core1, which also takes a requested zero here.
+uint16_t calibration_angle(uint16_t raw) {
+    uint16_t corrected = calibration_correct(raw);
+    if (zero_requested) {
+        zero_requested = false;
+        calibration.zero = corrected;
+        save_requested = true;
+        LOG(LOG_CALIBRATION_ZERO, corrected);
+    }
+    return (corrected - calibration.zero) & 4095;
+}
+
+// From core0 - the wheel is at its mechanical reference
+void calibration_set_zero() {
+    zero_requested = true;
+}
+
+// From core0 - the wheel has to be free to spin
+void calibration_start() {
+    if (fit_requested) { return; }
+    start_requested = true;
+}
+
+// From core0 - drops the table, the sensor is used uncorrected
+void calibration_clear() {
+    memset(calibration.lut, 0, sizeof(calibration.lut));
+    save_requested = true;
+}
+
+bool calibration_running() {
+    return start_requested || state != CALIBRATION_IDLE;
+}
+
+// Speed is near constant at fixed tension, so the counts against time are a
+// line plus the sensor error. The error is fitted as the first harmonics of the
+// measured angle over whole revolutions and the table cancels it.
+static bool calibration_fit() {
+    int32_t revolutions = abs(sample_counts[sample_count - 1] - sample_counts[0]) / 4096;
+    if (revolutions < CALIBRATION_MIN_REVOLUTIONS) {
+        LOG(LOG_CALIBRATION_FAILED, CALIBRATION_FAILED_REVOLUTIONS, revolutions);
+        return false;
+    }
+    uint32_t n = 0;
+    while (n < sample_count && abs(sample_counts[n] - sample_counts[0]) < revolutions * 4096) { n++; }
+
+    double st = 0.0, sc = 0.0, stt = 0.0, stc = 0.0;
+    for (uint32_t k = 0; k < n; k++) {
+        double t = (double)(sample_time_us[k] - sample_time_us[0]) / 1000000.0;
+        double c = sample_counts[k] - sample_counts[0];
+        st += t;
+        sc += c;
+        stt += t * t;
+        stc += t * c;
+    }
+    double slope = (n * stc - st * sc) / (n * stt - st * st);
+    double offset = (sc - slope * st) / n;
+
+    float cos_terms[CALIBRATION_HARMONICS] = { 0.0 };
+    float sin_terms[CALIBRATION_HARMONICS] = { 0.0 };
+    for (uint32_t k = 0; k < n; k++) {
+        float t = (float)(sample_time_us[k] - sample_time_us[0]) / 1000000.0f;
+        float residual = (float)((sample_counts[k] - sample_counts[0]) - (offset + slope * t));
+        float theta = (sample_counts[k] & 4095) * 2.0f * (float)M_PI / 4096.0f;
+        for (int h = 0; h < CALIBRATION_HARMONICS; h++) {
+            cos_terms[h] += residual * cosf((h + 1) * theta) * 2.0f / n;
+            sin_terms[h] += residual * sinf((h + 1) * theta) * 2.0f / n;
+        }
+    }
+
+    for (int i = 0; i < CALIBRATION_LUT_SIZE; i++) {
+        float theta = (i << CALIBRATION_LUT_SHIFT) * 2.0f * (float)M_PI / 4096.0f;
+        float error = 0.0f;
+        for (int h = 0; h < CALIBRATION_HARMONICS; h++) {
+            error += cos_terms[h] * cosf((h + 1) * theta) + sin_terms[h] * sinf((h + 1) * theta);
+        }
+        calibration.lut[i] = (int16_t)lroundf(-error);
+    }
+
+    LOG(LOG_CALIBRATION_DONE, n, revolutions,
+        log_f(sqrtf(cos_terms[0] * cos_terms[0] + sin_terms[0] * sin_terms[0])),
+        log_f(sqrtf(cos_terms[1] * cos_terms[1] + sin_terms[1] * sin_terms[1])));
+    return true;
+}
+
+// Called by run_cycle() while calibration_running(), returns the tension
+float calibration_cycle(bool valid, uint16_t raw, uint32_t now_us) {
+    if (state == CALIBRATION_IDLE) {
+        start_requested = false;
+        state = CALIBRATION_SPIN_UP;
+        started_at_us = now_us;
+        moved_at_us = now_us;
+        last_raw = raw;
+        unwrapped = raw;
+        sample_count = 0;
+        LOG(LOG_CALIBRATION_STARTED);
+    }
+
+    if (!valid) {
+        LOG(LOG_CALIBRATION_FAILED, CALIBRATION_FAILED_SENSOR, 0);
+        state = CALIBRATION_IDLE;
+        return 0.0;
+    }
+
+    int32_t step = (int32_t)raw - last_raw;
+    if (step > 2048) { step -= 4096; } else if (step < -2048) { step += 4096; }
+    unwrapped += step;
+    last_raw = raw;
+    if (step != 0) { moved_at_us = now_us; }
+    if (now_us - moved_at_us > CALIBRATION_STALL_MS * 1000) {
+        LOG(LOG_CALIBRATION_FAILED, CALIBRATION_FAILED_STALLED, 0);
+        state = CALIBRATION_IDLE;
+        return 0.0;
+    }
+
+    if (state == CALIBRATION_SPIN_UP) {
+        if (now_us - started_at_us >= CALIBRATION_SPIN_UP_MS * 1000) {
+            state = CALIBRATION_SAMPLING;
+            started_at_us = now_us;
+        }
+        return CALIBRATION_TENSION;
+    }
+
+    sample_time_us[sample_count] = now_us;
+    sample_counts[sample_count] = unwrapped;
+    sample_count++;
+
+    bool done = abs(unwrapped - sample_counts[0]) >= CALIBRATION_REVOLUTIONS * 4096;
+    if (done || sample_count == CALIBRATION_MAX_SAMPLES || now_us - started_at_us >= CALIBRATION_TIMEOUT_MS * 1000) {
+        // Fitted on core0, the samples stay untouched until the next start
+        fit_requested = true;
+        state = CALIBRATION_IDLE;
+        return 0.0;
+    }
+    return CALIBRATION_TENSION;
+}
+
+// Core0 task - fits a finished measurement and writes new tables to flash with core1 parked
+void calibration_task() {
+    if (fit_requested) {
+        if (calibration_fit()) {
+            save_requested = true;
+        }
+        fit_requested = false;
+    }
+    if (!save_requested) { return; }
+    save_requested = false;
+
+    static uint8_t page_buffer[(sizeof(calibration_t) + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE];
+    calibration.magic = CALIBRATION_MAGIC;
+    calibration.version = CALIBRATION_VERSION;
+    calibration.size = sizeof(calibration_t);
+    calibration.crc32 = calibration_crc(&calibration);
+    memset(page_buffer, 0xFF, sizeof(page_buffer));
+    memcpy(page_buffer, &calibration, sizeof(calibration_t));
+
+    // Core1 can't drive the motor while parked, let it coast meanwhile
+    motor_park();
+    multicore_lockout_start_blocking();
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(CALIBRATION_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(CALIBRATION_FLASH_OFFSET, page_buffer, sizeof(page_buffer));
+    restore_interrupts(interrupts);
+    multicore_lockout_end_blocking();
+    motor_resume();
+    LOG(LOG_CALIBRATION_SAVED);
+}
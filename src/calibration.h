@@ -0,0 +1,51 @@
+#ifndef CALIBRATION_H__
+#define CALIBRATION_H__
+
+#include "common/tusb_common.h"
+
+// Per-unit sensor calibration, kept in the last flash sector - it belongs to
+// the unit, not to a profile.
+//
+// The AS5600 is corrected for magnet eccentricity and mounting errors by a
+// table of CALIBRATION_LUT_SIZE corrections, linearly interpolated. The table is
+// measured by spinning the wheel at constant duty and fitting the sensor error
+// against time.
+//
+// Angle 0 is the unit's mechanical reference (the mark on the wheel). The zero is
+// set by holding the wheel at the mark and holding the menu key while in the
+// profile menu, or with FRAME_TYPE_CALIBRATE from python/calibrate.py --zero.
+
+#define CALIBRATION_LUT_SHIFT 6
+#define CALIBRATION_LUT_SIZE (4096 >> CALIBRATION_LUT_SHIFT)
+
+#define CALIBRATION_MAGIC 0x4C435745 // "EWCL"
+#define CALIBRATION_VERSION 2
+
+typedef struct TU_ATTR_PACKED
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint16_t zero;                       // corrected counts at the mechanical reference
+    uint16_t padding;
+    int16_t  lut[CALIBRATION_LUT_SIZE];  // raw counts added at raw = i << CALIBRATION_LUT_SHIFT
+    uint32_t crc32;                      // CRC-32 of everything before it
+} calibration_t;
+
+// Reference of the first unit, used until a zero is set
+#define CALIBRATION_DEFAULT_ZERO 1422
+
+#define CALIBRATION_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+// Measurement: tension while spinning, spin up before sampling and samples
+// needed. Only the first CALIBRATION_HARMONICS harmonics are fitted - the
+// eccentricity and tilt errors; higher ones would pick up speed ripple from cogging.
+#define CALIBRATION_TENSION 35
+#define CALIBRATION_SPIN_UP_MS 1000
+#define CALIBRATION_REVOLUTIONS 8
+#define CALIBRATION_MIN_REVOLUTIONS 2
+#define CALIBRATION_MAX_SAMPLES 1024
+#define CALIBRATION_TIMEOUT_MS 30000
+#define CALIBRATION_HARMONICS 2
+
+#endif /* CALIBRATION_H__ */
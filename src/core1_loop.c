@@ -1,32 +1,84 @@
 
 #include <math.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "bsp/board.h"
 #include "hardware/i2c.h"
 #include "hardware/pwm.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
 #include "pico/multicore.h"
 #include "profile.h"
 #include "neokey.h"
+#include "log.h"
+#include "telemetry.h"
+#include "i2c_bus.h"
+#include "scheduler.h"
+#include "boot.h"
+#include "current.h"
+#include "calibration.h"
+#include "sensor.h"
+#include "feedforward.h"
+#include "motor.h"
 
 extern volatile int16_t angle;
-extern profile_t profiles[9];
+extern volatile uint8_t angle_status;
+extern profile_t profiles[PROFILE_COUNT];
 extern uint32_t selected_profile;
 
 extern void init_pid(float kp_in, float ki_in, float kd_in, float gain_in, float dead_band_in);
 extern float process_pid(float error);
-
+extern void get_pid_terms(float* p_out, float* i_out, float* d_out);
+
+extern void telemetry_publish(const telemetry_t* sample);
+extern void effects_configure(const effect_t* effects);
+extern float effects_tension(int16_t angle, float velocity);
+extern void current_init(uint32_t pwm_frequency);
+extern void current_configure(uint32_t pwm_frequency);
+extern void current_set_target(float ma);
+extern float current_measured();
+extern uint16_t calibration_angle(uint16_t raw);
+extern bool calibration_running();
+extern float calibration_cycle(bool valid, uint16_t raw, uint32_t now_us);
+extern void feedforward_sample(float angle, uint32_t sample_us);
+extern float feedforward_velocity();
+extern float feedforward_predict(uint32_t now_us);
+extern float feedforward_tension();
+extern void flywheel_configure(uint16_t inertia_ms, uint16_t friction, uint32_t dividers);
+extern bool flywheel_enabled();
+extern float flywheel_update(float angle, float wheel_velocity, uint32_t now_us);
+extern void accel_configure(uint16_t gain, uint16_t low, uint16_t high, uint16_t curve);
+extern volatile uint8_t buttons_state;
+
+extern int i2c_bus_write(uint8_t device, uint8_t address, const uint8_t* src, size_t len, bool nostop);
+extern int i2c_bus_read(uint8_t device, uint8_t address, uint8_t* dst, size_t len, bool nostop);
+extern int i2c_bus_add_job(void (*fn)(), uint8_t priority);
+extern void i2c_bus_queue(int job);
+extern void i2c_bus_run(uint32_t deadline_us);
+extern void scheduler_wake(uint8_t source);
+
+extern void keys_configure(uint32_t debounce_time, uint32_t long_press);
 extern void write_leds();
 extern void show_leds();
 extern void read_keys_raw();
-extern uint8_t leds[12];
+extern void neokey_recovery_task();
+extern volatile uint8_t leds[NEOKEY_LEDS_SIZE];
 
 uint32_t current_millis;
 uint32_t overrun_millis;
 
+// AIN1 and AIN2 are the two channels of one PWM slice (see motor.h)
 #define PIN_AIN2 2
 #define PIN_AIN1 3
 #define PIN_PWM 0
 
+// Default motor PWM carrier, above hearing. Profiles can set their own.
+#define PWM_FREQUENCY 25000 // Hz
+// Largest clock divider, 8 integer and 4 fractional bits. It sets the lowest
+// carrier, about 8 Hz at 125 MHz; the highest a profile's uint16_t can ask for
+// still leaves over 10 bits of duty.
+#define PWM_MAX_DIVIDER16 (255 * 16 + 15)
+
 const uint8_t AS5600_ADDRESS = 0x36;
 
 static uint32_t stop = false;
@@ -43,11 +95,34 @@ static float distance = 0.0;
 static float tension = 0.0;
 
 static float last_angle = 0.0;
+static uint32_t last_angle_time_us = 0;
 static uint32_t last_status = 0;
+static uint16_t raw_angle = 0;
+static float sample_angle = 0.0;        // degrees, fractional
+static uint32_t sample_time_us = 0;     // when the sensor saw sample_angle
+static float control_angle = 0.0;       // angle the detents are worked out for
+static float velocity = 0.0;
+static uint32_t cycle = 0;
+
+static uint32_t invalid_cycles = 0;
+static sensor_faults_t sensor_faults;
+static sensor_faults_t reported_faults;
+static uint32_t sensor_stats_at = 0;
 
 static uint pwm_slice_num = 0;
 static uint pwn_channel = 0;
-static uint32_t pwm_frequency = 1000;
+static uint pwm_inputs_slice_num = 0;   // AIN1 and AIN2
+static uint32_t pwm_frequency = 0;
+static float pwm_level_per_percent = 0.0;
+static uint16_t pwm_level_high = 0;     // level that keeps a channel high all period
+static volatile uint8_t motor_decay = MOTOR_SLOW_DECAY;
+
+// Carrier of the selected profile. set_profile() on core0 bumps
+// pwm_config_requested, core1 reprograms the slices at the start of its next
+// cycle, never while it is writing a level.
+static volatile uint32_t pwm_frequency_requested = PWM_FREQUENCY;
+static volatile uint32_t pwm_config_requested = 0;
+static uint32_t pwm_config_applied = 0;
 
 
 float max_f(float a, float b) {
@@ -58,17 +133,102 @@ float min_f(float a, float b) {
     return a < b ? a : b;
 }
 
-uint32_t pwm_set_freq_duty(uint slice_num, uint chan, uint32_t f, int d) {
-    uint32_t clock = 125000000;
-    uint32_t divider16 = clock / f / 4096 + (clock % (f * 4096) != 0);
-    if (divider16 / 16 == 0) {
-        divider16 = 16;
+// Programs the carrier with the smallest divider that keeps the wrap in 16 bits,
+// for the finest duty the frequency allows. Only changes when the profile does,
+// the control cycle then just writes the level. On core1.
+static void pwm_configure() {
+    uint32_t requested = pwm_config_requested;
+    uint32_t frequency = pwm_frequency_requested;
+    pwm_config_applied = requested;
+    if (frequency == 0) { frequency = PWM_FREQUENCY; }
+    if (frequency == pwm_frequency) { return; }
+
+    uint32_t clock = clock_get_hz(clk_sys);
+    uint32_t min_frequency = (uint32_t)((uint64_t)clock * 16 / ((uint64_t)PWM_MAX_DIVIDER16 * 65535)) + 1;
+    if (frequency < min_frequency) { frequency = min_frequency; }
+    #if (CURRENT_LOOP)
+        if (frequency < CURRENT_MIN_PWM_FREQUENCY) { frequency = CURRENT_MIN_PWM_FREQUENCY; }
+        if (frequency > CURRENT_MAX_PWM_FREQUENCY) { frequency = CURRENT_MAX_PWM_FREQUENCY; }
+    #endif
+
+    // Divider in 1/16ths, wrap below 65535 so a channel can stay high
+    uint64_t per_wrap = (uint64_t)frequency * 65535;
+    uint32_t divider16 = (uint32_t)(((uint64_t)clock * 16 + per_wrap - 1) / per_wrap);
+    if (divider16 < 16) { divider16 = 16; }
+    if (divider16 > PWM_MAX_DIVIDER16) { divider16 = PWM_MAX_DIVIDER16; }
+    uint32_t wrap = (uint32_t)((uint64_t)clock * 16 / divider16 / frequency) - 1;
+
+    // Both slices restart together, edges of inputs and PWM pin line up; the
+    // current loop interrupt writes levels too and waits until it's done
+    uint32_t interrupts = save_and_disable_interrupts();
+    uint32_t slices = (1 << pwm_slice_num) | (1 << pwm_inputs_slice_num);
+    pwm_set_mask_enabled(pwm_hw->en & ~slices);
+    pwm_set_clkdiv_int_frac(pwm_slice_num, divider16 / 16, divider16 & 0xF);
+    pwm_set_wrap(pwm_slice_num, wrap);
+    pwm_set_counter(pwm_slice_num, 0);
+    pwm_set_clkdiv_int_frac(pwm_inputs_slice_num, divider16 / 16, divider16 & 0xF);
+    pwm_set_wrap(pwm_inputs_slice_num, wrap);
+    pwm_set_counter(pwm_inputs_slice_num, 0);
+    pwm_set_mask_enabled(pwm_hw->en | slices);
+    pwm_level_per_percent = (wrap + 1) / 100.0;
+    pwm_level_high = wrap + 1;
+    restore_interrupts(interrupts);
+    pwm_frequency = frequency;
+    current_configure(frequency);
+    LOG(LOG_PWM_CONFIGURED, frequency, wrap + 1);
+}
+
+// duty -100 to 100, the sign selects the H-bridge direction, motor_decay the off-time
+void motor_output(float duty) {
+    uint16_t level = (uint16_t)(fabsf(duty) * pwm_level_per_percent);
+    uint16_t ain1 = 0;
+    uint16_t ain2 = 0;
+    uint16_t enable = pwm_level_high;
+    switch (motor_decay) {
+        case (MOTOR_SLOW_DECAY): {
+            if (duty >= 0) { ain2 = pwm_level_high; } else { ain1 = pwm_level_high; }
+            enable = level;
+        }
+        break;
+        case (MOTOR_FAST_DECAY): {
+            if (duty >= 0) { ain2 = level; } else { ain1 = level; }
+        }
+        break;
+        default: break; // coast, both inputs low
     }
-    uint32_t wrap = clock * 16 / divider16 / f - 1;
-    pwm_set_clkdiv_int_frac(slice_num, divider16/16, divider16 & 0xF);
-    pwm_set_wrap(slice_num, wrap);
-    pwm_set_chan_level(slice_num, chan, wrap * d / 100);
-    return wrap;
+    pwm_set_gpio_level(PIN_AIN1, ain1);
+    pwm_set_gpio_level(PIN_AIN2, ain2);
+    pwm_set_chan_level(pwm_slice_num, pwn_channel, enable);
+}
+
+// Core0 parks core1 to write flash (calibration_task()) and the bridge would stay
+// latched at the last duty meanwhile - core1 lets it coast first
+static volatile bool park_requested = false;
+static volatile bool parked = false;
+
+// From core0, returns once the motor coasts and core1 has stopped driving it
+void motor_park() {
+    park_requested = true;
+    while (!parked) { tight_loop_contents(); }
+}
+
+// From core0, run_cycle() drives the motor again from its next cycle
+void motor_resume() {
+    park_requested = false;
+    while (parked) { tight_loop_contents(); }
+}
+
+// Bridge state for the tension run_cycle() just worked out, see motor.h
+static uint8_t select_decay(float tension, float velocity) {
+    #if (MOTOR_DECAY_AUTO)
+        if (fabsf(tension) < MOTOR_COAST_TENSION) {
+            return MOTOR_COAST;
+        }
+        if ((tension > 0) == (velocity > 0) && fabsf(tension) < fabsf(velocity) * MOTOR_BACK_EMF) {
+            return MOTOR_FAST_DECAY;
+        }
+    #endif
+    return MOTOR_SLOW_DECAY;
 }
 
 float angle_difference(float a1, float a2) {
@@ -89,40 +249,166 @@ float apply_expo(float value, float expo_percentage) {
     }
 }
 
-uint8_t as5600_reg[1] = {0x0B};
-uint8_t buf[5];
+uint8_t as5600_reg[1] = {AS5600_REG_STATUS};
+uint8_t buf[3];
+
+// Sensor settings of the selected profile. set_profile() on core0 bumps
+// sensor_config_requested, core1 writes CONF before its next read.
+static volatile uint16_t sensor_conf = 0;
+static volatile uint8_t sensor_oversample = 1;
+static volatile uint32_t sensor_config_requested = 0;
+static uint32_t sensor_config_applied = 0;
+static uint32_t sensor_delay_us = AS5600_FILTER_DELAY_US;
+
+static void sensor_configure() {
+    uint32_t requested = sensor_config_requested;
+    uint16_t conf = sensor_conf;
+    uint8_t data[3] = { AS5600_REG_CONF, conf >> 8, conf & 0xFF };
+    if (i2c_bus_write(I2C_DEVICE_AS5600, AS5600_ADDRESS, data, 3, false) < 0) {
+        return; // tried again next cycle
+    }
+    sensor_config_applied = requested;
+    sensor_delay_us = AS5600_FILTER_DELAY_US >> ((conf >> 8) & 0x3);
+    LOG(LOG_SENSOR_CONFIGURED, (conf >> 8) & 0x3, (conf >> 10) & 0x7, (conf >> 2) & 0x3, sensor_oversample);
+}
+
+// Median of a burst, taken as offsets from the first sample so a burst across 0 sorts right
+static uint16_t median_angle(const uint16_t* samples, uint32_t count) {
+    int16_t offsets[SENSOR_MAX_OVERSAMPLE];
+    for (uint32_t i = 0; i < count; i++) {
+        int16_t offset = ((samples[i] - samples[0] + 2048) & 4095) - 2048;
+        uint32_t j = i;
+        for (; j > 0 && offsets[j - 1] > offset; j--) {
+            offsets[j] = offsets[j - 1];
+        }
+        offsets[j] = offset;
+    }
+    return (samples[0] + offsets[count / 2]) & 4095;
+}
 
+// Reads STATUS and ANGLE, sensor_oversample times in a burst. Only a valid
+// sample changes angle (which stays -1 until the first one), angle_status
+// says what this read got.
 void read_angle() {
-    int ret = i2c_write_blocking(i2c_default, AS5600_ADDRESS, as5600_reg, 1, true);
+    if (sensor_config_applied != sensor_config_requested) {
+        sensor_configure();
+    }
+
+    uint8_t status;
+    uint32_t count = sensor_oversample;
+    uint16_t samples[SENSOR_MAX_OVERSAMPLE];
+    uint32_t first_at_us = 0;
+    uint32_t last_at_us = 0;
+    int ret = 0;
+    for (uint32_t n = 0; n < count && ret >= 0; n++) {
+        ret = i2c_bus_write(I2C_DEVICE_AS5600, AS5600_ADDRESS, as5600_reg, 1, true);
+        if (ret >= 0) {
+            last_at_us = time_us_32();
+            if (n == 0) { first_at_us = last_at_us; }
+            ret = i2c_bus_read(I2C_DEVICE_AS5600, AS5600_ADDRESS, buf, 3, false);
+            samples[n] = (buf[1] * 256 + buf[2]) & 0x0FFF;
+        }
+    }
     if (ret < 0) {
-        angle = ret - 2000;
+        status = SENSOR_I2C_ERROR;
+        sensor_faults.i2c_errors++;
+    } else if (!(buf[0] & AS5600_STATUS_MD)) {
+        status = SENSOR_MAGNET_MISSING;
+        sensor_faults.magnet_missing++;
     } else {
-        ret = i2c_read_blocking(i2c_default, AS5600_ADDRESS, buf, 5, false);
-        if (ret < 0) {
-            angle = ret - 3000;
-        } else {
-            int16_t new_angle = (buf[3] * 256 + buf[4]) * 360 / 4096;
-            new_angle += profiles[selected_profile].zero;
-            if (new_angle >= 360) {
-                new_angle -= 360;
-            } else if (new_angle < 0) {
-                new_angle += 360;
-            }
-            angle = new_angle;
+        status = SENSOR_VALID;
+        if (buf[0] & AS5600_STATUS_ML) {
+            status |= SENSOR_MAGNET_WEAK;
+            sensor_faults.magnet_weak++;
+        }
+        if (buf[0] & AS5600_STATUS_MH) {
+            status |= SENSOR_MAGNET_STRONG;
+            sensor_faults.magnet_strong++;
         }
+        raw_angle = count > 1 ? median_angle(samples, count) : samples[0];
+        uint16_t counts = calibration_angle(raw_angle);
+        sample_angle = counts * 360.0 / 4096.0;
+        sample_time_us = first_at_us + (last_at_us - first_at_us) / 2 - sensor_delay_us;
+        angle = counts * 360 / 4096;
     }
+    angle_status = status;
+}
+
+// Probed from core0 before core1 starts
+bool angle_sensor_ready() {
+    read_angle();
+    return angle_status & SENSOR_VALID;
+}
+
+static void report_sensor_faults(uint32_t now_us) {
+    if (now_us - sensor_stats_at < SENSOR_STATS_PERIOD_MS * 1000) { return; }
+    sensor_stats_at = now_us;
+    if (memcmp(&sensor_faults, &reported_faults, sizeof(sensor_faults_t)) == 0) { return; }
+
+    LOG(LOG_SENSOR_FAULTS, sensor_faults.i2c_errors, sensor_faults.magnet_missing,
+        sensor_faults.magnet_weak + sensor_faults.magnet_strong, sensor_faults.coasts);
+    reported_faults = sensor_faults;
 }
 
 void run_cycle() {
+    if (pwm_config_applied != pwm_config_requested) {
+        pwm_configure();
+    }
     read_angle();
 
-    desired_angle =  floor(((float)angle) / angle_of_retch) * angle_of_retch + half_angle;
+    uint32_t now_us = time_us_32();
+    bool valid = angle_status & SENSOR_VALID;
+    float error = 0.0;
+    if (valid) {
+        invalid_cycles = 0;
+        #if (FEEDFORWARD)
+            feedforward_sample(sample_angle, sample_time_us);
+            velocity = feedforward_velocity();
+            control_angle = feedforward_predict(now_us);
+        #else
+            if (now_us != last_angle_time_us) {
+                velocity = angle_difference(angle, last_angle) * 1000000.0 / (float)(now_us - last_angle_time_us);
+            }
+            last_angle = angle;
+            last_angle_time_us = now_us;
+            control_angle = angle;
+        #endif
 
-    float error = angle_difference(desired_angle, angle);
+        desired_angle =  floor(control_angle / angle_of_retch) * angle_of_retch + half_angle;
 
-    error = apply_expo(error / angle_of_retch, profiles[selected_profile].expo) * angle_of_retch;
+        error = angle_difference(desired_angle, control_angle);
 
-    tension = process_pid(error);
+        error = apply_expo(error / angle_of_retch, profiles[selected_profile].expo) * angle_of_retch;
+    } else {
+        invalid_cycles++;
+    }
+
+    if (calibration_running()) {
+        tension = calibration_cycle(valid, raw_angle, now_us);
+    } else if (valid) {
+        if (flywheel_enabled()) {
+            // Only the flywheel's drag - anything pushing along the wheel would
+            // keep it turning after the hand lets go
+            tension = flywheel_update(sample_angle, velocity, now_us);
+        } else {
+            tension = process_pid(error);
+            tension += effects_tension((int16_t)control_angle, velocity);
+            #if (FEEDFORWARD)
+                // Only while a detent holds the wheel, in the dead band it turns free
+                if (fabsf(error) > profiles[selected_profile].dead_band) {
+                    tension += feedforward_tension();
+                }
+            #endif
+        }
+    } else if (invalid_cycles > SENSOR_HOLD_CYCLES) {
+        // Nothing to hold against any more, let the wheel go
+        if (invalid_cycles == SENSOR_HOLD_CYCLES + 1) {
+            sensor_faults.coasts++;
+        }
+        angle_status |= SENSOR_COASTING;
+        tension = 0.0;
+    }
+    // else the tension of the last valid sample is held
 
     // if (tension < 0) {
     //     tension = max(-1.0, tension) * 100;
@@ -136,56 +422,109 @@ void run_cycle() {
         tension = min_f(100.0, tension);
     }
 
-    pwm_set_freq_duty(pwm_slice_num, pwn_channel, pwm_frequency, (int)((tension >= 0) ? tension : -tension));
-
-    int32_t tension_direction = ((tension > 0) ? 1 : -1) * profiles[selected_profile].direction;
-
-    if (tension_direction >= 0) {
-        gpio_put(PIN_AIN1, 0);
-        gpio_put(PIN_AIN2, 1);
-    } else if (tension_direction < 0) {
-        gpio_put(PIN_AIN1, 1);
-        gpio_put(PIN_AIN2, 0);
-    } else {
-        gpio_put(PIN_AIN1, 1);
-        gpio_put(PIN_AIN2, 1);
-    }
+    motor_decay = select_decay(tension, velocity);
+    float drive = tension * (int32_t)profiles[selected_profile].direction;
+    #if (CURRENT_LOOP)
+        current_set_target(drive * CURRENT_MAX_MA / 100.0);
+    #else
+        motor_output(drive);
+    #endif
+
+    float p, i, d;
+    get_pid_terms(&p, &i, &d);
+
+    telemetry_t telemetry = {
+        .time_us = now_us,
+        .cycle = cycle++,
+        .raw_angle = raw_angle,
+        .angle = angle,
+        .velocity = velocity,
+        .error = error,
+        .p = p,
+        .i = i,
+        .d = d,
+        .tension = tension,
+        .overrun_millis = overrun_millis,
+        .selected_profile = selected_profile,
+        .buttons_state = buttons_state,
+        .current = current_measured(),
+        .sensor_status = angle_status,
+        .sensor_faults = sensor_faults
+    };
+    telemetry_publish(&telemetry);
+    report_sensor_faults(now_us);
 }
 
 
 void core1_entry() {
-    printf("Started second core\n");
+    LOG(LOG_STARTED_SECOND_CORE);
+    // Parked while core0 writes flash
+    multicore_lockout_victim_init();
     bool overrun = false;
+    bool haptics_ready = false;
+    pwm_configure();
+    #if (CURRENT_LOOP)
+        current_init(pwm_frequency);
+    #endif
     uint32_t now = board_millis();
-    run_cycle_at = now + 10;
+    run_cycle_at = now;
+
+    int read_keys_job = i2c_bus_add_job(read_keys_raw, I2C_PRIORITY_KEYS);
+    int write_leds_job = i2c_bus_add_job(write_leds, I2C_PRIORITY_LEDS);
+    int show_leds_job = i2c_bus_add_job(show_leds, I2C_PRIORITY_LEDS);
+    int neokey_recovery_job = i2c_bus_add_job(neokey_recovery_task, I2C_PRIORITY_BACKGROUND);
+
     while (true) {
+        if (park_requested) {
+            if (!parked) {
+                motor_decay = MOTOR_COAST;
+                #if (CURRENT_LOOP)
+                    current_set_target(0.0);
+                #endif
+                motor_output(0.0);
+                parked = true;
+            }
+            continue;
+        }
+        parked = false;
+
         now = board_millis();
         current_millis = now;
         if (now >= run_cycle_at) {
+            uint32_t cycle_started_at = time_us_32();
             run_cycle();
+            if (!haptics_ready && (angle_status & SENSOR_VALID)) {
+                LOG(LOG_BOOT_PHASE, BOOT_PHASE_HAPTICS, time_us_32());
+                haptics_ready = true;
+            }
 
+            // Neokey work is spread over cycles; the arbiter runs it after the
+            // angle read, deferring anything that doesn't fit this cycle
             switch (cycle_counter) {
                 case (1): {
-                    read_keys_raw();
+                    i2c_bus_queue(read_keys_job);
                     cycle_counter += 1;
                     break;
                 }
                 case (2): {
-                    write_leds();
-                    show_leds();
+                    i2c_bus_queue(write_leds_job);
                     cycle_counter += 1;
                     break;
                 }
                 case (3): {
+                    i2c_bus_queue(show_leds_job);
                     cycle_counter = 0;
                     break;
                 }
                 default:
                 {
+                    i2c_bus_queue(neokey_recovery_job);
                     cycle_counter += 1;
                     break;
                 }
             }
+            i2c_bus_run(cycle_started_at + I2C_BUS_CYCLE_BUDGET_US);
+            scheduler_wake(SCHEDULER_WAKE_CORE1);
 
             run_cycle_at = now + 10;
             if (overrun) {
@@ -202,7 +541,7 @@ void core1_entry() {
 }
 
 void set_profile(uint32_t selected_profile_number) {
-    if (selected_profile_number >= 0 && selected_profile_number < 9) {
+    if (selected_profile_number >= 0 && selected_profile_number < PROFILE_COUNT) {
         selected_profile = selected_profile_number;
 
         float gain = profiles[selected_profile].gain_factor * ((float)profiles[selected_profile].dividers) / 1.25;
@@ -211,27 +550,49 @@ void set_profile(uint32_t selected_profile_number) {
         angle_of_retch = (360.0 / (float)profiles[selected_profile].dividers);
         half_angle = angle_of_retch / 2.0;
         half_distance_tension_factor = 100.0 / half_angle;
+
+        effects_configure(profiles[selected_profile].effects);
+        flywheel_configure(
+            profiles[selected_profile].flywheel_inertia,
+            profiles[selected_profile].flywheel_friction,
+            profiles[selected_profile].dividers);
+        accel_configure(
+            profiles[selected_profile].accel_gain,
+            profiles[selected_profile].accel_low,
+            profiles[selected_profile].accel_high,
+            profiles[selected_profile].accel_curve);
+        pwm_frequency_requested = profiles[selected_profile].pwm_frequency;
+        pwm_config_requested++;
+
+        uint8_t oversample = profiles[selected_profile].sensor_oversample;
+        sensor_oversample = oversample < 1 ? 1 : (oversample > SENSOR_MAX_OVERSAMPLE ? SENSOR_MAX_OVERSAMPLE : oversample);
+        sensor_conf = AS5600_CONF(
+            profiles[selected_profile].sensor_filter,
+            profiles[selected_profile].sensor_fast_threshold,
+            profiles[selected_profile].sensor_hysteresis);
+        sensor_config_requested++;
+
+        keys_configure(
+            profiles[selected_profile].key_debounce_time ? profiles[selected_profile].key_debounce_time : KEY_DEBOUNCE_TIME,
+            profiles[selected_profile].key_long_press_time ? profiles[selected_profile].key_long_press_time : KEY_LONG_PRESS_TIME);
     }
 }
 
 void start_second_core() {
 
-    set_profile(selected_profile);
-
-    gpio_init(PIN_AIN1);
-    gpio_set_dir(PIN_AIN1, GPIO_OUT);
-    gpio_put(PIN_AIN1, 0);
-    gpio_init(PIN_AIN2);
-    gpio_set_dir(PIN_AIN2, GPIO_OUT);
-    gpio_put(PIN_AIN2, 0);
-
+    // Inputs low (coast) from the start, core1 sets up the carrier when it starts
+    gpio_set_function(PIN_AIN1, GPIO_FUNC_PWM);
+    gpio_set_function(PIN_AIN2, GPIO_FUNC_PWM);
     gpio_set_function(PIN_PWM, GPIO_FUNC_PWM);
 
     pwm_slice_num = pwm_gpio_to_slice_num(PIN_PWM);
     pwn_channel = pwm_gpio_to_channel(PIN_PWM);
-    pwm_set_freq_duty(pwm_slice_num, pwn_channel, pwm_frequency, 100);
-    pwm_set_enabled(pwm_slice_num, true);
+    pwm_inputs_slice_num = pwm_gpio_to_slice_num(PIN_AIN1);
+    pwm_set_gpio_level(PIN_AIN1, 0);
+    pwm_set_gpio_level(PIN_AIN2, 0);
+    pwm_set_chan_level(pwm_slice_num, pwn_channel, 0);
+    set_profile(selected_profile);
 
-    printf("Starting second core\n");
+    LOG(LOG_STARTING_SECOND_CORE);
     multicore_launch_core1(core1_entry);
 }
@@ -0,0 +1,105 @@
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "current.h"
+#include "log.h"
+
+extern void motor_output(float duty);
+
+static uint16_t blocks[2][CURRENT_BLOCK_SAMPLES];
+static int dma_channels[2] = { -1, -1 };
+
+static volatile uint32_t calibration_blocks = CURRENT_CALIBRATION_BLOCKS;
+static uint32_t calibration_sum = 0;
+static float zero_counts = 0.0;
+static bool zero_reported = false;
+
+static volatile float target_ma = 0.0;
+static volatile float measured_ma = 0.0;
+static float integral = 0.0;
+
+static float current_loop(float measured) {
+    float error = target_ma - measured;
+    float next_integral = integral + error * CURRENT_KI;
+    float duty = error * CURRENT_KP + next_integral;
+    // No integration while saturated
+    if (duty > -100.0 && duty < 100.0) {
+        integral = next_integral;
+    }
+    return duty > 100.0 ? 100.0 : (duty < -100.0 ? -100.0 : duty);
+}
+
+static void __not_in_flash_func(current_dma_irq)() {
+    for (int b = 0; b < 2; b++) {
+        if (!dma_channel_get_irq1_status(dma_channels[b])) { continue; }
+        dma_channel_acknowledge_irq1(dma_channels[b]);
+
+        // The other channel is filling its block now, this one gets re-armed for after it
+        uint32_t sum = 0;
+        for (int i = 0; i < CURRENT_BLOCK_SAMPLES; i++) { sum += blocks[b][i]; }
+        dma_channel_set_write_addr(dma_channels[b], blocks[b], false);
+
+        if (calibration_blocks > 0) {
+            calibration_sum += sum;
+            if (--calibration_blocks == 0) {
+                zero_counts = (float)calibration_sum / (CURRENT_CALIBRATION_BLOCKS * CURRENT_BLOCK_SAMPLES);
+            }
+            continue;
+        }
+
+        float measured = ((float)sum / CURRENT_BLOCK_SAMPLES - zero_counts) * CURRENT_MA_PER_COUNT;
+        measured_ma = measured;
+        motor_output(current_loop(measured));
+    }
+}
+
+// ADC sample rate follows the PWM carrier, a whole number of samples per period;
+// a carrier out of CURRENT_MIN/MAX_PWM_FREQUENCY gets the nearest rate the ADC has
+void current_configure(uint32_t pwm_frequency) {
+    if (dma_channels[0] < 0) { return; }
+    float divider = (float)CURRENT_ADC_CLOCK / (pwm_frequency * CURRENT_SAMPLES_PER_PERIOD) - 1;
+    if (divider < 95.0) { divider = 95.0; } else if (divider > 65535.0) { divider = 65535.0; }
+    adc_set_clkdiv(divider);
+}
+
+// Called on core1 with the motor off - the first blocks calibrate zero current
+void current_init(uint32_t pwm_frequency) {
+    adc_init();
+    adc_gpio_init(CURRENT_ADC_PIN);
+    adc_select_input(CURRENT_ADC_INPUT);
+    adc_fifo_setup(true, true, 1, false, false);
+
+    dma_channels[0] = dma_claim_unused_channel(true);
+    dma_channels[1] = dma_claim_unused_channel(true);
+    current_configure(pwm_frequency);
+    for (int b = 0; b < 2; b++) {
+        dma_channel_config config = dma_channel_get_default_config(dma_channels[b]);
+        channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+        channel_config_set_read_increment(&config, false);
+        channel_config_set_write_increment(&config, true);
+        channel_config_set_dreq(&config, DREQ_ADC);
+        channel_config_set_chain_to(&config, dma_channels[1 - b]);
+        dma_channel_configure(dma_channels[b], &config, blocks[b], &adc_hw->fifo, CURRENT_BLOCK_SAMPLES, false);
+        dma_channel_set_irq1_enabled(dma_channels[b], true);
+    }
+    irq_set_exclusive_handler(DMA_IRQ_1, current_dma_irq);
+    irq_set_enabled(DMA_IRQ_1, true);
+
+    dma_channel_start(dma_channels[0]);
+    adc_run(true);
+}
+
+// mA, sign as the duty - takes over from run_cycle() writing the duty
+void current_set_target(float ma) {
+    target_ma = ma;
+}
+
+// From run_cycle(), which also logs the zero once it is known - not allowed in the interrupt
+float current_measured() {
+    if (!zero_reported && dma_channels[0] >= 0 && calibration_blocks == 0) {
+        zero_reported = true;
+        LOG(LOG_CURRENT_CALIBRATED, (uint32_t)zero_counts);
+    }
+    return measured_ma;
+}
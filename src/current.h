@@ -0,0 +1,41 @@
+#ifndef CURRENT_H__
+#define CURRENT_H__
+
+// Optional inner current loop. With a current sense amplifier on the ADC,
+// run_cycle() asks for a motor current instead of a duty, so the detent torque
+// no longer changes with supply voltage, winding temperature or back-EMF.
+//
+// The ADC runs free at CURRENT_SAMPLES_PER_PERIOD samples per PWM period and DMA
+// fills ping-pong blocks of whole PWM periods; the mean of a block is the mean
+// motor current whatever the ripple. The PI loop runs on every block in the
+// DMA interrupt on core1. Gains are tuned with python/simulator.py.
+#define CURRENT_LOOP 0
+
+// Bidirectional inline amplifier (INA240 or alike) referenced to mid-supply,
+// positive for positive duty. Zero is calibrated at start with the motor off.
+#define CURRENT_ADC_PIN 26
+#define CURRENT_ADC_INPUT 0
+#define CURRENT_SHUNT_MILLIOHM 100
+#define CURRENT_SENSE_GAIN 20
+#define CURRENT_MA_PER_COUNT (3300.0 * 1000.0 / 4096.0 / CURRENT_SHUNT_MILLIOHM / CURRENT_SENSE_GAIN)
+
+// Motor current at tension 100
+#define CURRENT_MAX_MA 500.0
+
+#define CURRENT_SAMPLES_PER_PERIOD 8
+
+// Carrier range that keeps whole ADC samples per period: a conversion takes 96
+// cycles of the 48 MHz ADC clock and the divider has a 16 bit integer part.
+// pwm_configure() holds the carrier inside it with the loop on.
+#define CURRENT_ADC_CLOCK 48000000
+#define CURRENT_MIN_PWM_FREQUENCY (CURRENT_ADC_CLOCK / 65536 / CURRENT_SAMPLES_PER_PERIOD + 1)   // Hz
+#define CURRENT_MAX_PWM_FREQUENCY (CURRENT_ADC_CLOCK / 96 / CURRENT_SAMPLES_PER_PERIOD)          // Hz
+#define CURRENT_BLOCK_PERIODS 5     // loop runs at carrier / CURRENT_BLOCK_PERIODS
+#define CURRENT_BLOCK_SAMPLES (CURRENT_SAMPLES_PER_PERIOD * CURRENT_BLOCK_PERIODS)
+#define CURRENT_CALIBRATION_BLOCKS 64
+
+// PI, duty percent per mA; KI per loop run
+#define CURRENT_KP 0.04
+#define CURRENT_KI 0.08
+
+#endif /* CURRENT_H__ */
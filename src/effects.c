@@ -0,0 +1,105 @@
+#include <math.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "bsp/board.h"
+#include "profile.h"
+#include "effects.h"
+
+extern float angle_difference(float a1, float a2);
+
+// Only the configured effects of the selected profile, nothing to do per cycle
+// without any. Core1 only - it takes a new set from pending before a cycle.
+static effect_t active[PROFILE_EFFECT_COUNT];
+static int active_count = 0;
+
+// Set from core0, sequence lock - odd sequence means core0 is in the middle of an update
+static effect_t pending[PROFILE_EFFECT_COUNT];
+static int pending_count = 0;
+static volatile uint32_t pending_sequence = 0;
+static uint32_t applied_sequence = 0;
+
+void effects_configure(const effect_t* effects) {
+    pending_sequence += 1;
+    __dmb();
+    int count = 0;
+    for (int i = 0; i < PROFILE_EFFECT_COUNT; i++) {
+        if (effects[i].type != EFFECT_NONE && effects[i].strength != 0) {
+            pending[count++] = effects[i];
+        }
+    }
+    pending_count = count;
+    __dmb();
+    pending_sequence += 1;
+}
+
+// A set changed under the copy is left for the next cycle
+static void effects_apply() {
+    uint32_t sequence = pending_sequence;
+    if (sequence == applied_sequence || (sequence & 1)) { return; }
+    effect_t copy[PROFILE_EFFECT_COUNT];
+    __dmb();
+    int count = pending_count;
+    memcpy(copy, pending, sizeof(copy));
+    __dmb();
+    if (sequence != pending_sequence) { return; }
+    memcpy(active, copy, sizeof(copy));
+    active_count = count;
+    applied_sequence = sequence;
+}
+
+static int32_t wrap_degrees(int32_t degrees) {
+    degrees %= 360;
+    return degrees < 0 ? degrees + 360 : degrees;
+}
+
+static float clamp_unit(float value) {
+    return value > 1.0 ? 1.0 : (value < -1.0 ? -1.0 : value);
+}
+
+static float end_stops(const effect_t* effect, int16_t angle) {
+    int32_t length = wrap_degrees(effect->end - effect->start);
+    int32_t position = wrap_degrees(angle - effect->start);
+    if (position <= length) { return 0.0; }
+
+    // Pushed back towards the nearer end
+    int32_t past_end = position - length;
+    int32_t before_start = 360 - position;
+    if (past_end < before_start) {
+        return -effect->strength * clamp_unit((float)past_end / EFFECT_END_STOP_RAMP);
+    }
+    return effect->strength * clamp_unit((float)before_start / EFFECT_END_STOP_RAMP);
+}
+
+static float spring(const effect_t* effect, int16_t angle) {
+    float range = effect->end > 0 ? effect->end : 180.0;
+    return -effect->strength * clamp_unit(angle_difference(angle, effect->start) / range);
+}
+
+static float friction(const effect_t* effect, float velocity) {
+    return -effect->strength * clamp_unit(velocity / EFFECT_FRICTION_VELOCITY);
+}
+
+// A hill: pushes away from 'start' on both sides, zero at the top and the edges
+static float barrier(const effect_t* effect, int16_t angle) {
+    float half_width = (effect->end > 0 ? effect->end : EFFECT_BARRIER_WIDTH) / 2.0;
+    float distance = angle_difference(angle, effect->start);
+    if (distance <= -half_width || distance >= half_width) { return 0.0; }
+    return effect->strength * sinf(M_PI * distance / half_width);
+}
+
+// Tension of all active effects, added to the detent tension by run_cycle()
+float effects_tension(int16_t angle, float velocity) {
+    effects_apply();
+    float tension = 0.0;
+    for (int i = 0; i < active_count; i++) {
+        const effect_t* effect = &active[i];
+        switch (effect->type) {
+            case (EFFECT_END_STOPS): tension += end_stops(effect, angle); break;
+            case (EFFECT_SPRING): tension += spring(effect, angle); break;
+            case (EFFECT_FRICTION): tension += friction(effect, velocity); break;
+            case (EFFECT_BARRIER): tension += barrier(effect, angle); break;
+            default: break;
+        }
+    }
+    return tension;
+}
@@ -0,0 +1,13 @@
+#ifndef EFFECTS_H__
+#define EFFECTS_H__
+
+// End stops reach full strength this many degrees past the end
+#define EFFECT_END_STOP_RAMP 3
+
+// Friction reaches full strength at this speed
+#define EFFECT_FRICTION_VELOCITY 720.0 // degrees per second
+
+// Barrier width when 'end' is 0
+#define EFFECT_BARRIER_WIDTH 10 // degrees
+
+#endif /* EFFECTS_H__ */
@@ -0,0 +1,62 @@
+#include <math.h>
+#include "pico/stdlib.h"
+#include "feedforward.h"
+#include "motor.h"
+
+extern float angle_difference(float a1, float a2);
+
+static bool tracking = false;
+static float position = 0.0;       // degrees 0..360, at last_sample_us
+static float velocity = 0.0;       // degrees/s
+static float acceleration = 0.0;   // degrees/s^2
+static uint32_t last_sample_us = 0;
+
+static float wrap_angle(float a) {
+    a = fmodf(a, 360.0);
+    if (a < 0.0) { a += 360.0; }
+    return a < 360.0 ? a : 0.0;
+}
+
+// Valid sample, degrees, taken at sample_us
+void feedforward_sample(float angle, uint32_t sample_us) {
+    uint32_t dt_us = sample_us - last_sample_us;
+    if (!tracking || dt_us == 0 || dt_us > FEEDFORWARD_MAX_GAP_US) {
+        tracking = true;
+        position = angle;
+        velocity = 0.0;
+        acceleration = 0.0;
+        last_sample_us = sample_us;
+        return;
+    }
+
+    float dt = dt_us / 1000000.0;
+    float predicted = wrap_angle(position + velocity * dt);
+    float residual = angle_difference(angle, predicted);
+    float last_velocity = velocity;
+
+    position = wrap_angle(predicted + FEEDFORWARD_ALPHA * residual);
+    velocity += FEEDFORWARD_BETA * residual / dt;
+    acceleration += ((velocity - last_velocity) / dt - acceleration) * FEEDFORWARD_ACCEL_FILTER;
+    last_sample_us = sample_us;
+}
+
+float feedforward_velocity() {
+    return velocity;
+}
+
+// Angle expected FEEDFORWARD_LOOKAHEAD_US after now, while the tension set now is applied
+float feedforward_predict(uint32_t now_us) {
+    float ahead = (now_us - last_sample_us + FEEDFORWARD_LOOKAHEAD_US) / 1000000.0;
+    return wrap_angle(position + velocity * ahead);
+}
+
+float feedforward_tension() {
+    float friction = velocity / FEEDFORWARD_FRICTION_VELOCITY;
+    if (friction > 1.0) { friction = 1.0; } else if (friction < -1.0) { friction = -1.0; }
+
+    float drag = friction * FEEDFORWARD_FRICTION + velocity * FEEDFORWARD_VISCOUS;
+    float drag_max = fabsf(velocity) * MOTOR_BACK_EMF;
+    if (drag > drag_max) { drag = drag_max; } else if (drag < -drag_max) { drag = -drag_max; }
+
+    return drag + acceleration * FEEDFORWARD_INERTIA;
+}
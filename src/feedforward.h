@@ -0,0 +1,37 @@
+#ifndef FEEDFORWARD_H__
+#define FEEDFORWARD_H__
+
+// Latency compensation. The angle run_cycle() gets is already old by the AS5600
+// output filter and the I2C transfer, and the tension it sets is then held for a
+// whole 10 ms cycle - at speed the detents lag and smear. Each sample is
+// timestamped, less the AS5600 filter delay (see sensor.h), an alpha-beta
+// observer tracks angle and velocity, and the detent law works on the angle
+// predicted for the middle of the next cycle. Friction, back-EMF drag and rotor
+// inertia are compensated by feed-forward terms.
+// Gains and the improvement are checked with python/simulator.py.
+#define FEEDFORWARD 1
+
+// Prediction target past run_cycle(): half the control period
+#define FEEDFORWARD_LOOKAHEAD_US 5000
+
+// Observer gains per sample; critically damped pair (beta = alpha^2 / (2 - alpha))
+#define FEEDFORWARD_ALPHA 0.5
+#define FEEDFORWARD_BETA 0.167
+// Samples older than this restart the observer
+#define FEEDFORWARD_MAX_GAP_US 50000
+
+// Acceleration is the observer velocity differentiated and low-passed
+#define FEEDFORWARD_ACCEL_FILTER 0.3
+
+// Feed-forward, tension percent:
+//   friction - Coulomb, full above FEEDFORWARD_FRICTION_VELOCITY
+//   viscous  - per degree/s, back-EMF braking
+//   inertia  - per degree/s^2, part of the rotor inertia
+// Friction and viscous together never exceed the back-EMF braking of the bridge
+// (MOTOR_BACK_EMF, see motor.h) - more would push the wheel along with the hand.
+#define FEEDFORWARD_FRICTION 0.0
+#define FEEDFORWARD_FRICTION_VELOCITY 20.0 // degrees/s
+#define FEEDFORWARD_VISCOUS 0.0035
+#define FEEDFORWARD_INERTIA 0.003
+
+#endif /* FEEDFORWARD_H__ */
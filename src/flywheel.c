@@ -0,0 +1,73 @@
+#include <math.h>
+#include "pico/stdlib.h"
+#include "flywheel.h"
+
+extern float angle_difference(float a1, float a2);
+
+// Wheel action steps since start, read by wheel_task() on core0
+volatile int32_t flywheel_steps = 0;
+
+static volatile float inertia = 0.0;       // s, 0 when off
+static volatile float friction = 0.0;      // degrees/s^2
+static volatile float step_angle = 360.0;
+static volatile bool restart = true;
+
+static float velocity = 0.0;                // flywheel degrees/s
+static float position = 0.0;                // degrees since the last step
+static float last_angle = 0.0;
+static uint32_t last_us = 0;
+
+void flywheel_configure(uint16_t inertia_ms, uint16_t friction_in, uint32_t dividers) {
+    inertia = inertia_ms / 1000.0;
+    friction = friction_in;
+    step_angle = 360.0 / (dividers ? dividers : 1);
+    restart = true;
+}
+
+bool flywheel_enabled() {
+    return inertia > 0.0;
+}
+
+// Every control cycle with a valid sample, returns the drag tension
+float flywheel_update(float angle, float wheel_velocity, uint32_t now_us) {
+    if (restart) {
+        restart = false;
+        velocity = 0.0;
+        position = 0.0;
+        last_angle = angle;
+        last_us = now_us;
+        return 0.0;
+    }
+
+    float dt = (now_us - last_us) / 1000000.0;
+    float wheel_delta = angle_difference(angle, last_angle);
+    last_angle = angle;
+    last_us = now_us;
+
+    float drag = 0.0;
+    bool same_direction = velocity == 0.0 || (wheel_velocity > 0.0) == (velocity > 0.0);
+    if (!same_direction && fabsf(wheel_velocity) > FLYWHEEL_STOP_VELOCITY) {
+        velocity = 0.0;
+    } else if (same_direction && fabsf(wheel_velocity) > fabsf(velocity)) {
+        // Hand is ahead - spins the flywheel up and feels its weight
+        float slip = wheel_velocity - velocity;
+        velocity += dt >= inertia ? slip : slip * dt / inertia;
+        drag = -slip * FLYWHEEL_DRAG;
+    } else {
+        float loss = (friction + fabsf(velocity) * FLYWHEEL_VISCOUS) * dt;
+        if (fabsf(velocity) <= loss + FLYWHEEL_MIN_VELOCITY) {
+            velocity = 0.0;
+        } else {
+            velocity -= velocity > 0.0 ? loss : -loss;
+        }
+    }
+
+    float flywheel_delta = velocity * dt;
+    position += fabsf(wheel_delta) > fabsf(flywheel_delta) ? wheel_delta : flywheel_delta;
+    int32_t steps = (int32_t)(position / step_angle);
+    if (steps != 0) {
+        position -= steps * step_angle;
+        flywheel_steps += steps;
+    }
+    return drag;
+}
@@ -0,0 +1,25 @@
+#ifndef FLYWHEEL_H__
+#define FLYWHEEL_H__
+
+// Flywheel mode (profile flywheel_inertia above 0): the wheel drives a virtual
+// flywheel through a one-way clutch. Turning faster than the flywheel spins it
+// up over flywheel_inertia ms and the motor drags against the hand meanwhile;
+// once the hand lets go the flywheel coasts down by flywheel_friction degrees/s
+// every second. Wheel actions get one step per 360 / dividers degrees of
+// whichever is ahead, the hand or the flywheel; detents, effects and feed-forward
+// are off.
+// Runs on core1 from the sample of the control cycle, no extra I2C reads.
+
+// Drag while spinning up, tension percent per degree/s the hand is ahead
+#define FLYWHEEL_DRAG 0.02
+
+// Turning against the flywheel faster than this stops it
+#define FLYWHEEL_STOP_VELOCITY 90.0 // degrees/s
+
+// Speed lost per second while coasting on top of the profile's friction
+#define FLYWHEEL_VISCOUS 0.2
+
+// Coasting below this stops
+#define FLYWHEEL_MIN_VELOCITY 5.0 // degrees/s
+
+#endif /* FLYWHEEL_H__ */
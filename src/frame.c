@@ -0,0 +1,116 @@
+#include "tusb.h"
+#include "frame.h"
+
+extern uint16_t crc16_ccitt(uint16_t crc, const uint8_t* data, size_t len);
+extern void telemetry_stream_enable(bool enable);
+extern void calibration_start();
+extern void calibration_clear();
+extern void calibration_set_zero();
+
+enum {
+    RX_SYNC = 0,
+    RX_TYPE,
+    RX_LEN,
+    RX_PAYLOAD,
+    RX_CRC_LO,
+    RX_CRC_HI,
+};
+
+static uint8_t rx_state = RX_SYNC;
+static uint8_t rx_type;
+static uint8_t rx_len;
+static uint8_t rx_pos;
+static uint16_t rx_crc;
+static uint8_t rx_payload[FRAME_MAX_PAYLOAD];
+
+// Never blocks - returns false if the host is not listening or there
+// is no room for the whole frame in the CDC buffer.
+bool frame_send(uint8_t type, const void* payload, uint8_t len) {
+    if (!tud_cdc_connected()) { return false; }
+    if (tud_cdc_write_available() < (uint32_t)len + FRAME_OVERHEAD) { return false; }
+
+    uint8_t header[3] = { FRAME_SYNC, type, len };
+    uint16_t crc = crc16_ccitt(0xFFFF, header + 1, 2);
+    crc = crc16_ccitt(crc, payload, len);
+    uint8_t footer[2] = { crc & 0xFF, crc >> 8 };
+
+    tud_cdc_write(header, sizeof(header));
+    tud_cdc_write(payload, len);
+    tud_cdc_write(footer, sizeof(footer));
+    return true;
+}
+
+void process_frame(uint8_t type, const uint8_t* payload, uint8_t len) {
+    switch (type) {
+        case (FRAME_TYPE_STREAM): {
+            if (len >= 1) {
+                telemetry_stream_enable(payload[0] != 0);
+            }
+        }
+        break;
+        case (FRAME_TYPE_CALIBRATE): {
+            if (len >= 1) {
+                if (payload[0] == 2) {
+                    calibration_set_zero();
+                } else if (payload[0] != 0) {
+                    calibration_start();
+                } else {
+                    calibration_clear();
+                }
+            }
+        }
+        break;
+        default: break;
+    }
+}
+
+// Parses frames (commands) received from the host
+void cdc_task() {
+    uint8_t data[64];
+
+    if (!tud_cdc_available()) { return; }
+
+    uint32_t count = tud_cdc_read(data, sizeof(data));
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t b = data[i];
+        switch (rx_state) {
+            case (RX_SYNC): {
+                if (b == FRAME_SYNC) { rx_state = RX_TYPE; }
+            }
+            break;
+            case (RX_TYPE): {
+                rx_type = b;
+                rx_state = RX_LEN;
+            }
+            break;
+            case (RX_LEN): {
+                rx_len = b;
+                rx_pos = 0;
+                rx_state = rx_len > 0 ? RX_PAYLOAD : RX_CRC_LO;
+            }
+            break;
+            case (RX_PAYLOAD): {
+                rx_payload[rx_pos++] = b;
+                if (rx_pos == rx_len) { rx_state = RX_CRC_LO; }
+            }
+            break;
+            case (RX_CRC_LO): {
+                rx_crc = b;
+                rx_state = RX_CRC_HI;
+            }
+            break;
+            case (RX_CRC_HI): {
+                rx_crc |= (uint16_t)b << 8;
+                uint8_t header[2] = { rx_type, rx_len };
+                uint16_t crc = crc16_ccitt(0xFFFF, header, 2);
+                crc = crc16_ccitt(crc, rx_payload, rx_len);
+                if (crc == rx_crc) {
+                    process_frame(rx_type, rx_payload, rx_len);
+                }
+                rx_state = RX_SYNC;
+            }
+            break;
+            default: rx_state = RX_SYNC; break;
+        }
+    }
+}
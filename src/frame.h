@@ -0,0 +1,23 @@
+#ifndef FRAME_H__
+#define FRAME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Binary frames sent over CDC:
+//   [FRAME_SYNC][type][len][payload (len bytes)][crc16 lo][crc16 hi]
+// crc16 is CRC-16/CCITT-FALSE over type, len and payload.
+// Anything outside of a valid frame is plain text (debug printf).
+
+#define FRAME_SYNC 0xA5
+#define FRAME_OVERHEAD 5
+#define FRAME_MAX_PAYLOAD 255
+
+enum {
+    FRAME_TYPE_LOG = 1,       // device -> host, log record (log.c)
+    FRAME_TYPE_TELEMETRY,     // device -> host, telemetry_t of every control cycle
+    FRAME_TYPE_STREAM,        // host -> device, [1] start / [0] stop telemetry stream
+    FRAME_TYPE_CALIBRATE,     // host -> device, [1] measure / [0] clear sensor calibration, [2] set zero here
+};
+
+#endif /* FRAME_H__ */
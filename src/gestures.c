@@ -0,0 +1,221 @@
+#include "pico/stdlib.h"
+#include "bsp/board.h"
+#include "profile.h"
+#include "neokey.h"
+#include "gestures.h"
+#include "log.h"
+
+#define DEBUG_GESTURES 0
+
+extern profile_t profiles[PROFILE_COUNT];
+extern uint32_t selected_profile;
+
+extern void hid_action_press(key_action_t action);
+extern void hid_action_release(key_action_t action);
+extern void hid_action_click(key_action_t action);
+extern void hid_action_wheel(key_action_t action, int32_t detents);
+
+// Per key state. Keys with no gestures bound go straight to GESTURE_STATE_PLAIN
+// and act on press; others wait in GESTURE_STATE_PRESSED until one gesture
+// is certain. Every state resolves within GESTURE_CHORD_TIME, the long press
+// time or GESTURE_DOUBLE_TAP_TIME after release.
+enum {
+    GESTURE_STATE_IDLE = 0,
+    GESTURE_STATE_PLAIN,        // action held until release
+    GESTURE_STATE_PRESSED,      // waiting for chord, hold, wheel or release
+    GESTURE_STATE_WAIT_SECOND,  // released, waiting for a double tap
+    GESTURE_STATE_HELD,         // hold action held until release
+    GESTURE_STATE_CONSUMED,     // resolved, nothing left to do on release
+};
+
+typedef struct {
+    uint8_t state;
+    uint32_t time;              // press, or release when waiting for the second tap
+    key_action_t held;          // action to release
+} gesture_key_t;
+
+static gesture_key_t keys[NEOKEY_MAX_KEYS];
+
+static const gesture_t* find_gesture(uint8_t type, uint8_t key) {
+    const gesture_t* gestures = profiles[selected_profile].gestures;
+    for (int i = 0; i < PROFILE_GESTURE_COUNT; i++) {
+        if (gestures[i].type == type
+                && (gestures[i].key_a == key || (type == GESTURE_CHORD && gestures[i].key_b == key))) {
+            return &gestures[i];
+        }
+    }
+    return NULL;
+}
+
+static bool has_gestures(uint8_t key) {
+    const gesture_t* gestures = profiles[selected_profile].gestures;
+    for (int i = 0; i < PROFILE_GESTURE_COUNT; i++) {
+        if (gestures[i].type != GESTURE_NONE
+                && (gestures[i].key_a == key || (gestures[i].type == GESTURE_CHORD && gestures[i].key_b == key))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool only_chords(uint8_t key) {
+    return !find_gesture(GESTURE_DOUBLE_TAP, key) && !find_gesture(GESTURE_HOLD, key) && !find_gesture(GESTURE_WHEEL_ALT, key);
+}
+
+static void dispatch(uint8_t type, uint8_t key, key_action_t action) {
+    #if (DEBUG_GESTURES)
+        LOG(LOG_GESTURE, type, key, action.type << 24 | action.sub_type << 16 | (uint16_t)action.value);
+    #endif
+    hid_action_click(action);
+}
+
+static void press_plain(uint8_t key) {
+    keys[key].held = profiles[selected_profile].keys[key];
+    keys[key].state = GESTURE_STATE_PLAIN;
+    hid_action_press(keys[key].held);
+}
+
+static bool press_chord(uint8_t key, uint32_t time) {
+    const gesture_t* gestures = profiles[selected_profile].gestures;
+    for (int i = 0; i < PROFILE_GESTURE_COUNT; i++) {
+        if (gestures[i].type != GESTURE_CHORD) { continue; }
+
+        uint8_t partner;
+        if (gestures[i].key_a == key) {
+            partner = gestures[i].key_b;
+        } else if (gestures[i].key_b == key) {
+            partner = gestures[i].key_a;
+        } else {
+            continue;
+        }
+        if (partner < NEOKEY_MAX_KEYS
+                && keys[partner].state == GESTURE_STATE_PRESSED
+                && time - keys[partner].time <= GESTURE_CHORD_TIME) {
+            dispatch(GESTURE_CHORD, key, gestures[i].action);
+            keys[partner].state = GESTURE_STATE_CONSUMED;
+            keys[key].state = GESTURE_STATE_CONSUMED;
+            return true;
+        }
+    }
+    return false;
+}
+
+// key - key number as seen on the wheel (NEOKEY_KEY_NO)
+void gestures_key_event(uint8_t key, uint8_t event, uint32_t time) {
+    if (key >= NEOKEY_MAX_KEYS) { return; }
+    gesture_key_t* k = &keys[key];
+
+    switch (event) {
+        case (KEY_PRESSED): {
+            if (k->state == GESTURE_STATE_WAIT_SECOND) {
+                const gesture_t* gesture = find_gesture(GESTURE_DOUBLE_TAP, key);
+                if (gesture) {
+                    dispatch(GESTURE_DOUBLE_TAP, key, gesture->action);
+                }
+                k->state = GESTURE_STATE_CONSUMED;
+            } else if (!press_chord(key, time)) {
+                if (has_gestures(key)) {
+                    k->state = GESTURE_STATE_PRESSED;
+                    k->time = time;
+                } else {
+                    press_plain(key);
+                }
+            }
+        }
+        break;
+        case (KEY_LONG_PRESSED): {
+            if (k->state == GESTURE_STATE_PRESSED) {
+                const gesture_t* gesture = find_gesture(GESTURE_HOLD, key);
+                if (gesture) {
+                    #if (DEBUG_GESTURES)
+                        LOG(LOG_GESTURE, GESTURE_HOLD, key, 0);
+                    #endif
+                    k->held = gesture->action;
+                    k->state = GESTURE_STATE_HELD;
+                    hid_action_press(k->held);
+                }
+            }
+        }
+        break;
+        case (KEY_RELEASED): {
+            switch (k->state) {
+                case (GESTURE_STATE_PLAIN):
+                case (GESTURE_STATE_HELD): {
+                    hid_action_release(k->held);
+                    k->state = GESTURE_STATE_IDLE;
+                }
+                break;
+                case (GESTURE_STATE_PRESSED): {
+                    if (find_gesture(GESTURE_DOUBLE_TAP, key)) {
+                        k->state = GESTURE_STATE_WAIT_SECOND;
+                        k->time = time;
+                    } else {
+                        dispatch(GESTURE_NONE, key, profiles[selected_profile].keys[key]);
+                        k->state = GESTURE_STATE_IDLE;
+                    }
+                }
+                break;
+                case (GESTURE_STATE_CONSUMED): {
+                    k->state = GESTURE_STATE_IDLE;
+                }
+                break;
+                default: break;
+            }
+        }
+        break;
+        default: break;
+    }
+}
+
+// Key was taken over by something else (the profile menu) - drop what it was doing
+void gestures_cancel(uint8_t key) {
+    if (key >= NEOKEY_MAX_KEYS) { return; }
+    gesture_key_t* k = &keys[key];
+    if (k->state == GESTURE_STATE_PLAIN || k->state == GESTURE_STATE_HELD) {
+        hid_action_release(k->held);
+    }
+    k->state = k->state == GESTURE_STATE_WAIT_SECOND ? GESTURE_STATE_IDLE : GESTURE_STATE_CONSUMED;
+}
+
+static bool wheel_alt_key(uint8_t key) {
+    return (keys[key].state == GESTURE_STATE_PRESSED
+            || keys[key].state == GESTURE_STATE_CONSUMED
+            || keys[key].state == GESTURE_STATE_HELD)
+        && find_gesture(GESTURE_WHEEL_ALT, key);
+}
+
+bool gestures_wheel_alt() {
+    for (int key = 0; key < NEOKEY_MAX_KEYS; key++) {
+        if (wheel_alt_key(key)) { return true; }
+    }
+    return false;
+}
+
+// detents turned since last call, positive for increasing angle
+void gestures_wheel(int32_t detents) {
+    bool alt = false;
+    for (int key = 0; key < NEOKEY_MAX_KEYS; key++) {
+        if (wheel_alt_key(key)) {
+            alt = true;
+            // Used as modifier, so no tap on release
+            if (keys[key].state == GESTURE_STATE_PRESSED) {
+                keys[key].state = GESTURE_STATE_CONSUMED;
+            }
+        }
+    }
+    hid_action_wheel(alt ? profiles[selected_profile].wheel_alt : profiles[selected_profile].wheel_main, detents);
+}
+
+// Resolves gestures that time out
+void gestures_task() {
+    uint32_t now = board_millis();
+    for (int key = 0; key < NEOKEY_MAX_KEYS; key++) {
+        gesture_key_t* k = &keys[key];
+        if (k->state == GESTURE_STATE_WAIT_SECOND && now - k->time > GESTURE_DOUBLE_TAP_TIME) {
+            dispatch(GESTURE_NONE, key, profiles[selected_profile].keys[key]);
+            k->state = GESTURE_STATE_IDLE;
+        } else if (k->state == GESTURE_STATE_PRESSED && now - k->time > GESTURE_CHORD_TIME && only_chords(key)) {
+            press_plain(key);
+        }
+    }
+}
@@ -0,0 +1,12 @@
+#ifndef GESTURES_H__
+#define GESTURES_H__
+
+// Time a second tap has to follow the first to make a double tap.
+// Taps of keys with a double tap bound are delayed by this much.
+#define GESTURE_DOUBLE_TAP_TIME 250 // ms
+
+// Keys of a chord must go down within this time of each other. Keys that are
+// only part of chords and not pressed with their partner act as plain keys after it.
+#define GESTURE_CHORD_TIME 60 // ms
+
+#endif /* GESTURES_H__ */
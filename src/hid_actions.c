@@ -0,0 +1,245 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "joystick_hid.h"
+#include "profile.h"
+
+// Reports are queued so that a press and its release, or several clicks
+// resolved in the same pass, each reach the host - only one report can be
+// sent per HID poll interval.
+#define HID_REPORT_QUEUE_SIZE 32
+#define HID_REPORT_MAX_SIZE (sizeof(hid_joystick_report_t))
+
+typedef struct {
+    uint8_t report_id;
+    uint8_t len;
+    uint8_t data[HID_REPORT_MAX_SIZE];
+} hid_queued_report_t;
+
+static hid_queued_report_t report_queue[HID_REPORT_QUEUE_SIZE];
+static uint32_t report_queue_head = 0;
+static uint32_t report_queue_tail = 0;
+uint32_t hid_reports_dropped = 0;
+
+// Longest time from tud_hid_report() to its transfer completing, reset by msc_task()
+// for every burst of MSC writes so uploads can be seen not to delay reports
+uint32_t hid_report_latency_max_us = 0;
+static uint32_t report_sent_us = 0;
+static bool report_in_flight = false;
+
+static hid_keyboard_report_t keyboard_report = { 0 };
+static uint8_t mouse_buttons = 0;
+static uint16_t consumer_usage = 0;
+static hid_joystick_report_t joystick_report = { 0 };
+
+static hid_queued_report_t* queue_report(uint8_t report_id, const void* data, uint8_t len) {
+    if (report_queue_head - report_queue_tail >= HID_REPORT_QUEUE_SIZE) {
+        hid_reports_dropped += 1;
+        return NULL;
+    }
+    hid_queued_report_t* report = &report_queue[report_queue_head % HID_REPORT_QUEUE_SIZE];
+    report->report_id = report_id;
+    report->len = len;
+    memcpy(report->data, data, len);
+    report_queue_head += 1;
+    return report;
+}
+
+// Last queued report if it is of this type and not sent yet
+static hid_queued_report_t* pending_report(uint8_t report_id) {
+    if (report_queue_head == report_queue_tail) { return NULL; }
+    hid_queued_report_t* report = &report_queue[(report_queue_head - 1) % HID_REPORT_QUEUE_SIZE];
+    return report->report_id == report_id ? report : NULL;
+}
+
+static void queue_keyboard_report() {
+    queue_report(REPORT_ID_KEYBOARD, &keyboard_report, sizeof(keyboard_report));
+}
+
+static void queue_mouse_report(int8_t wheel, int8_t pan) {
+    hid_mouse_report_t report = { .buttons = mouse_buttons, .wheel = wheel, .pan = pan };
+    hid_queued_report_t* pending = pending_report(REPORT_ID_MOUSE);
+    if (pending && (wheel || pan) && ((hid_mouse_report_t*)pending->data)->buttons == mouse_buttons) {
+        // Merge wheel steps into the report still waiting to be sent
+        hid_mouse_report_t* merged = (hid_mouse_report_t*)pending->data;
+        if (merged->wheel + wheel >= -127 && merged->wheel + wheel <= 127
+            && merged->pan + pan >= -127 && merged->pan + pan <= 127) {
+            merged->wheel += wheel;
+            merged->pan += pan;
+            return;
+        }
+    }
+    queue_report(REPORT_ID_MOUSE, &report, sizeof(report));
+}
+
+// Angle updates replace a pending report with the same buttons, button changes are always queued
+static void queue_joystick_report() {
+    hid_queued_report_t* pending = pending_report(REPORT_ID_JOYSTICK);
+    if (pending && ((hid_joystick_report_t*)pending->data)->buttons == joystick_report.buttons) {
+        memcpy(pending->data, &joystick_report, sizeof(joystick_report));
+    } else {
+        queue_report(REPORT_ID_JOYSTICK, &joystick_report, sizeof(joystick_report));
+    }
+}
+
+static void keyboard_press(uint8_t keycode, uint8_t modifier) {
+    keyboard_report.modifier |= modifier;
+    for (int i = 0; i < 6 && keycode; i++) {
+        if (keyboard_report.keycode[i] == keycode) { break; }
+        if (keyboard_report.keycode[i] == 0) {
+            keyboard_report.keycode[i] = keycode;
+            break;
+        }
+    }
+    queue_keyboard_report();
+}
+
+static void keyboard_release(uint8_t keycode, uint8_t modifier) {
+    keyboard_report.modifier &= ~modifier;
+    for (int i = 0; i < 6 && keycode; i++) {
+        if (keyboard_report.keycode[i] == keycode) {
+            memmove(&keyboard_report.keycode[i], &keyboard_report.keycode[i + 1], 5 - i);
+            keyboard_report.keycode[5] = 0;
+            break;
+        }
+    }
+    queue_keyboard_report();
+}
+
+void hid_action_press(key_action_t action) {
+    switch (action.type) {
+        case (REPORT_ID_KEYBOARD): {
+            keyboard_press(action.value, action.sub_type);
+        }
+        break;
+        case (REPORT_ID_MOUSE): {
+            if (action.sub_type <= MOUSE_MIDDLE_BUTTON) {
+                mouse_buttons |= 1 << action.sub_type;
+                queue_mouse_report(0, 0);
+            }
+        }
+        break;
+        case (REPORT_ID_CONSUMER): {
+            consumer_usage = action.value;
+            queue_report(REPORT_ID_CONSUMER, &consumer_usage, sizeof(consumer_usage));
+        }
+        break;
+        case (REPORT_ID_JOYSTICK): {
+            if (action.value >= 0 && action.value < 32) {
+                joystick_report.buttons |= 1u << action.value;
+                queue_joystick_report();
+            }
+        }
+        break;
+        default: break;
+    }
+}
+
+void hid_action_release(key_action_t action) {
+    switch (action.type) {
+        case (REPORT_ID_KEYBOARD): {
+            keyboard_release(action.value, action.sub_type);
+        }
+        break;
+        case (REPORT_ID_MOUSE): {
+            if (action.sub_type <= MOUSE_MIDDLE_BUTTON) {
+                mouse_buttons &= ~(1 << action.sub_type);
+                queue_mouse_report(0, 0);
+            }
+        }
+        break;
+        case (REPORT_ID_CONSUMER): {
+            if (consumer_usage == (uint16_t)action.value) {
+                consumer_usage = 0;
+                queue_report(REPORT_ID_CONSUMER, &consumer_usage, sizeof(consumer_usage));
+            }
+        }
+        break;
+        case (REPORT_ID_JOYSTICK): {
+            if (action.value >= 0 && action.value < 32) {
+                joystick_report.buttons &= ~(1u << action.value);
+                queue_joystick_report();
+            }
+        }
+        break;
+        default: break;
+    }
+}
+
+void hid_action_click(key_action_t action) {
+    hid_action_press(action);
+    hid_action_release(action);
+}
+
+// detents - positive for increasing angle
+void hid_action_wheel(key_action_t action, int32_t detents) {
+    switch (action.type) {
+        case (REPORT_ID_MOUSE): {
+            int32_t steps = detents * (action.value ? action.value : 1);
+            if (steps > 127) { steps = 127; }
+            if (steps < -127) { steps = -127; }
+            if (action.sub_type == MOUSE_WHEEL_Y) {
+                queue_mouse_report(steps, 0);
+            } else if (action.sub_type == MOUSE_WHEEL_X) {
+                queue_mouse_report(0, steps);
+            }
+        }
+        break;
+        case (REPORT_ID_KEYBOARD): {
+            uint8_t keycode = detents > 0 ? (action.value & 0xFF) : ((uint16_t)action.value >> 8);
+            for (int32_t i = 0; i < (detents > 0 ? detents : -detents); i++) {
+                keyboard_press(keycode, action.sub_type);
+                keyboard_release(keycode, action.sub_type);
+            }
+        }
+        break;
+        default: break;
+    }
+}
+
+// Absolute angle for joystick wheel actions
+void hid_action_angle(key_action_t action, int16_t angle) {
+    if (action.type != REPORT_ID_JOYSTICK && action.type != 0) { return; }
+
+    switch (action.value) {
+        case (JOYSTICK_AXIS_0): {
+            joystick_report.x = angle;
+        }
+        break;
+        case (JOYSTICK_AXIS_1): {
+            joystick_report.y = angle;
+        }
+        break;
+        case (JOYSTICK_AXIS_2): {
+            joystick_report.z = angle;
+        }
+        break;
+        default: return;
+    }
+    queue_joystick_report();
+}
+
+void hid_actions_task() {
+    if (report_queue_head == report_queue_tail || !tud_hid_ready()) { return; }
+
+    hid_queued_report_t* report = &report_queue[report_queue_tail % HID_REPORT_QUEUE_SIZE];
+    if (tud_hid_report(report->report_id, report->data, report->len)) {
+        report_queue_tail += 1;
+        report_sent_us = time_us_32();
+        report_in_flight = true;
+    }
+}
+
+// Invoked by tud_task() when the host has taken the report
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len) {
+    (void) instance;
+    (void) report;
+    (void) len;
+    if (!report_in_flight) { return; }
+    report_in_flight = false;
+
+    uint32_t latency_us = time_us_32() - report_sent_us;
+    if (latency_us > hid_report_latency_max_us) {
+        hid_report_latency_max_us = latency_us;
+    }
+}
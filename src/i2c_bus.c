@@ -0,0 +1,130 @@
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "i2c_bus.h"
+#include "log.h"
+
+typedef void (*i2c_bus_job_fn)();
+
+typedef struct {
+    i2c_bus_job_fn fn;
+    uint8_t priority;
+    bool pending;
+    uint32_t estimate_us;       // decaying maximum of measured run time
+} i2c_bus_job_t;
+
+typedef struct {
+    uint32_t baudrate;
+    uint32_t busy_us;
+    uint32_t transfers;
+    uint32_t errors;
+} i2c_bus_device_t;
+
+static i2c_bus_device_t devices[I2C_DEVICE_COUNT] = {
+    [I2C_DEVICE_AS5600] = { .baudrate = I2C_BUS_AS5600_BAUDRATE },
+    [I2C_DEVICE_NEOKEY] = { .baudrate = I2C_BUS_NEOKEY_BAUDRATE },
+};
+static uint32_t current_baudrate = I2C_BUS_BAUDRATE;
+
+static i2c_bus_job_t jobs[I2C_BUS_MAX_JOBS];
+static int job_count = 0;
+static uint32_t jobs_deferred = 0;
+static uint32_t longest_job_us = 0;
+static uint32_t stats_started_at = 0;
+
+static uint32_t transfer_timeout_us(uint8_t device, size_t len) {
+    // 9 clocks per byte plus address
+    uint32_t nominal = (len + 1) * 9 * 1000000 / devices[device].baudrate;
+    uint32_t timeout = nominal * I2C_BUS_TIMEOUT_FACTOR;
+    return timeout < I2C_BUS_TIMEOUT_MIN_US ? I2C_BUS_TIMEOUT_MIN_US : timeout;
+}
+
+static void select_device(uint8_t device) {
+    if (devices[device].baudrate != current_baudrate) {
+        i2c_set_baudrate(i2c_default, devices[device].baudrate);
+        current_baudrate = devices[device].baudrate;
+    }
+}
+
+static void account(uint8_t device, uint32_t started_at, int ret) {
+    devices[device].busy_us += time_us_32() - started_at;
+    devices[device].transfers += 1;
+    if (ret < 0) { devices[device].errors += 1; }
+}
+
+int i2c_bus_write(uint8_t device, uint8_t address, const uint8_t* src, size_t len, bool nostop) {
+    select_device(device);
+    uint32_t started_at = time_us_32();
+    int ret = i2c_write_timeout_us(i2c_default, address, src, len, nostop, transfer_timeout_us(device, len));
+    account(device, started_at, ret);
+    return ret;
+}
+
+int i2c_bus_read(uint8_t device, uint8_t address, uint8_t* dst, size_t len, bool nostop) {
+    select_device(device);
+    uint32_t started_at = time_us_32();
+    int ret = i2c_read_timeout_us(i2c_default, address, dst, len, nostop, transfer_timeout_us(device, len));
+    account(device, started_at, ret);
+    return ret;
+}
+
+int i2c_bus_add_job(i2c_bus_job_fn fn, uint8_t priority) {
+    if (job_count >= I2C_BUS_MAX_JOBS) { return -1; }
+    jobs[job_count] = (i2c_bus_job_t){ .fn = fn, .priority = priority, .pending = false, .estimate_us = 0 };
+    return job_count++;
+}
+
+void i2c_bus_queue(int job) {
+    if (job >= 0 && job < job_count) {
+        jobs[job].pending = true;
+    }
+}
+
+static void report_stats(uint32_t now_us) {
+    uint32_t period_us = now_us - stats_started_at;
+    if (period_us < I2C_BUS_STATS_PERIOD_MS * 1000) { return; }
+
+    for (uint8_t device = 0; device < I2C_DEVICE_COUNT; device++) {
+        LOG(LOG_I2C_UTILISATION, device,
+            (uint32_t)((uint64_t)devices[device].busy_us * 1000 / period_us),
+            devices[device].transfers, devices[device].errors);
+        devices[device].busy_us = 0;
+        devices[device].transfers = 0;
+        devices[device].errors = 0;
+    }
+    LOG(LOG_I2C_JOBS, jobs_deferred, longest_job_us);
+    jobs_deferred = 0;
+    longest_job_us = 0;
+    stats_started_at = now_us;
+}
+
+// Runs pending jobs, highest priority first, as long as each is expected to
+// finish before 'deadline_us'. The first job of a call always runs so a job
+// longer than the budget can't be starved forever.
+void i2c_bus_run(uint32_t deadline_us) {
+    bool first = true;
+    while (true) {
+        i2c_bus_job_t* next = NULL;
+        for (int i = 0; i < job_count; i++) {
+            if (jobs[i].pending && (next == NULL || jobs[i].priority < next->priority)) {
+                next = &jobs[i];
+            }
+        }
+        if (next == NULL) { break; }
+
+        uint32_t now = time_us_32();
+        if ((int32_t)(deadline_us - now) <= 0 || (!first && (int32_t)(deadline_us - now - next->estimate_us) < 0)) {
+            jobs_deferred += 1;
+            break;
+        }
+
+        next->pending = false;
+        next->fn();
+        uint32_t took = time_us_32() - now;
+
+        next->estimate_us -= next->estimate_us / 16;
+        if (took > next->estimate_us) { next->estimate_us = took; }
+        if (took > longest_job_us) { longest_job_us = took; }
+        first = false;
+    }
+    report_stats(time_us_32());
+}
@@ -0,0 +1,45 @@
+#ifndef I2C_BUS_H__
+#define I2C_BUS_H__
+
+// All I2C traffic goes through i2c_bus.c. The angle read runs at the start of
+// every control cycle; everything else is a queued job that only runs when
+// it fits in the rest of the cycle, so it can never push the next angle read.
+
+enum {
+    I2C_DEVICE_AS5600 = 0,
+    I2C_DEVICE_NEOKEY,
+    I2C_DEVICE_COUNT,
+};
+
+// Bus clock per device. AS5600 can do fast mode plus (1 MHz) but breakout
+// pull-ups are usually too weak for it - set I2C_BUS_FAST_PLUS with stronger ones.
+// Seesaw (Neokey) is good for 400 kHz.
+#define I2C_BUS_FAST_PLUS 0
+#define I2C_BUS_BAUDRATE (400 * 1000)
+#if (I2C_BUS_FAST_PLUS)
+#define I2C_BUS_AS5600_BAUDRATE (1000 * 1000)
+#else
+#define I2C_BUS_AS5600_BAUDRATE (400 * 1000)
+#endif
+#define I2C_BUS_NEOKEY_BAUDRATE (400 * 1000)
+
+// Part of the 10ms control cycle jobs may use, the rest is headroom for the
+// angle read and control loop of the next cycle
+#define I2C_BUS_CYCLE_BUDGET_US 7000
+
+// Transfers that take longer than this many times their nominal time are abandoned
+#define I2C_BUS_TIMEOUT_FACTOR 4
+#define I2C_BUS_TIMEOUT_MIN_US 500
+
+#define I2C_BUS_MAX_JOBS 8
+
+// Lower runs first
+enum {
+    I2C_PRIORITY_KEYS = 0,
+    I2C_PRIORITY_LEDS,
+    I2C_PRIORITY_BACKGROUND,
+};
+
+#define I2C_BUS_STATS_PERIOD_MS 10000
+
+#endif /* I2C_BUS_H__ */
@@ -0,0 +1,130 @@
+#include <math.h>
+#include "pico/stdlib.h"
+#include "neokey.h"
+#include "led_animation.h"
+
+extern volatile uint8_t leds[NEOKEY_LEDS_SIZE];
+
+typedef struct {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+} led_colour_t;
+
+// Colours set by the UI, indexed by key number as seen on the wheel
+static led_colour_t base[NEOKEY_MAX_KEYS];
+
+// Precomputed at init: perceived brightness -> output scale, and per-frame
+// scales of the breathing and tick envelopes with gamma already applied
+static uint8_t gamma_table[256];
+static uint8_t breathe_table[LED_BREATHE_FRAMES];
+static uint8_t tick_table[LED_TICK_FRAMES];
+
+static uint16_t breathing_keys = 0;
+static uint32_t frame = 0;
+static uint32_t tick_frame = 0;
+static bool tick_pending = false;
+static uint8_t velocity_level = 0;
+static uint8_t error_code = LED_ERROR_NONE;
+static uint32_t error_frame = 0;
+
+void led_animation_init() {
+    for (int i = 0; i < 256; i++) {
+        gamma_table[i] = (uint8_t)(powf(i / 255.0f, LED_GAMMA) * 255.0f + 0.5f);
+    }
+    for (int i = 0; i < LED_BREATHE_FRAMES; i++) {
+        float phase = (1.0f - cosf(2.0f * (float)M_PI * i / LED_BREATHE_FRAMES)) / 2.0f;
+        breathe_table[i] = gamma_table[(uint8_t)(LED_BREATHE_MIN + (255 - LED_BREATHE_MIN) * phase)];
+    }
+    for (int i = 0; i < LED_TICK_FRAMES; i++) {
+        tick_table[i] = gamma_table[255 - 255 * i / LED_TICK_FRAMES];
+    }
+}
+
+void led_set_base(int key, uint8_t r, uint8_t g, uint8_t b) {
+    if (key < 0 || key >= NEOKEY_MAX_KEYS) { return; }
+    base[key] = (led_colour_t){ .r = r, .g = g, .b = b };
+}
+
+void led_set_breathing(uint16_t keys) {
+    if (keys && !breathing_keys) { frame = 0; }
+    breathing_keys = keys;
+}
+
+void led_tick() {
+    tick_pending = true;
+}
+
+void led_set_velocity(float velocity) {
+    float level = fabsf(velocity) / LED_VELOCITY_FULL_SCALE;
+    velocity_level = level >= 1.0f ? 255 : (uint8_t)(level * 255.0f);
+}
+
+void led_set_error(uint8_t code) {
+    if (code != error_code) {
+        error_code = code;
+        error_frame = 0;
+    }
+}
+
+static uint8_t scale(uint8_t value, uint8_t factor) {
+    return (value * factor + 255) >> 8;
+}
+
+static uint8_t blend(uint8_t from, uint8_t to, uint8_t level) {
+    return from + (((int)to - from) * level) / 255;
+}
+
+static uint8_t add(uint8_t a, uint8_t b) {
+    return a + b > 255 ? 255 : a + b;
+}
+
+static bool error_blink_on() {
+    uint32_t length = error_code * 2 * LED_ERROR_BLINK_FRAMES + LED_ERROR_PAUSE_FRAMES;
+    uint32_t position = error_frame % length;
+    if (position >= error_code * 2 * LED_ERROR_BLINK_FRAMES) { return false; }
+    return (position / LED_ERROR_BLINK_FRAMES) % 2 == 0;
+}
+
+// One frame per run, the scheduler runs it every LED_FRAME_PERIOD
+void led_animation_task() {
+    if (tick_pending) {
+        tick_pending = false;
+        tick_frame = LED_TICK_FRAMES;
+    }
+
+    for (int key = 0; key < NEOKEY_MAX_KEYS; key++) {
+        led_colour_t c = base[key];
+
+        if (breathing_keys & (1 << key)) {
+            uint8_t factor = breathe_table[frame % LED_BREATHE_FRAMES];
+            c.r = scale(c.r, factor);
+            c.g = scale(c.g, factor);
+            c.b = scale(c.b, factor);
+        } else if (key == LED_STATUS_KEY) {
+            uint8_t level = gamma_table[velocity_level];
+            c.r = blend(c.r, LED_VELOCITY_R, level);
+            c.g = blend(c.g, LED_VELOCITY_G, level);
+            c.b = blend(c.b, LED_VELOCITY_B, level);
+            if (tick_frame > 0) {
+                uint8_t factor = tick_table[LED_TICK_FRAMES - tick_frame];
+                c.r = add(c.r, scale(LED_TICK_R, factor));
+                c.g = add(c.g, scale(LED_TICK_G, factor));
+                c.b = add(c.b, scale(LED_TICK_B, factor));
+            }
+        }
+
+        if (key == LED_STATUS_KEY && error_code != LED_ERROR_NONE) {
+            c = error_blink_on() ? (led_colour_t){ .r = 32 } : (led_colour_t){ 0 };
+        }
+
+        int i = NEOKEY_KEY_NO(key) * 3;
+        leds[i] = c.g;
+        leds[i + 1] = c.r;
+        leds[i + 2] = c.b;
+    }
+
+    frame += 1;
+    error_frame += 1;
+    if (tick_frame > 0) { tick_frame -= 1; }
+}
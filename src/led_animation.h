@@ -0,0 +1,42 @@
+#ifndef LED_ANIMATION_H__
+#define LED_ANIMATION_H__
+
+// Frames are rendered into the Neokey LED buffer at a fixed rate. core1 writes
+// changed boards out every KEY_SAMPLE_PERIOD (at most NEOKEY_LED_WRITES_PER_CALL),
+// so rendering faster than that would only burn cycles - and rendering
+// can never add more I2C time than that budget.
+#define LED_FRAME_PERIOD 40 // ms, not less than KEY_SAMPLE_PERIOD
+
+// Key showing detent ticks, velocity and error codes
+#define LED_STATUS_KEY 3
+
+#define LED_GAMMA 2.2
+
+// Menu keys breathe with this period
+#define LED_BREATHE_FRAMES 50
+#define LED_BREATHE_MIN 64  // perceived brightness at the bottom of a breath, 0-255
+
+// Flash on every detent the wheel passes
+#define LED_TICK_FRAMES 4
+#define LED_TICK_R 24
+#define LED_TICK_G 24
+#define LED_TICK_B 24
+
+// Status key blends from its colour towards this one as the wheel speeds up
+#define LED_VELOCITY_FULL_SCALE 720.0 // degrees/s
+#define LED_VELOCITY_R 0
+#define LED_VELOCITY_G 16
+#define LED_VELOCITY_B 32
+
+// Error blink code - 'code' short red blinks on the status key, then a pause
+#define LED_ERROR_BLINK_FRAMES 5
+#define LED_ERROR_PAUSE_FRAMES 25
+
+enum {
+    LED_ERROR_NONE = 0,
+    LED_ERROR_SENSOR = 2,       // AS5600 not answering
+    LED_ERROR_OVERRUN = 3,      // control loop overran its cycle
+    LED_ERROR_MAGNET = 4,       // AS5600 magnet missing, too weak or too strong
+};
+
+#endif /* LED_ANIMATION_H__ */
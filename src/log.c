@@ -0,0 +1,87 @@
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "frame.h"
+#include "log.h"
+
+extern bool frame_send(uint8_t type, const void* payload, uint8_t len);
+
+#define LOG_RING_SIZE 64 // records per core, power of 2
+
+typedef struct TU_ATTR_PACKED
+{
+    uint32_t time_us;
+    uint16_t id;
+    uint8_t  core;
+    uint8_t  arg_count;
+    uint32_t args[LOG_MAX_ARGS];
+} log_record_t;
+
+// Single producer (the owning core) / single consumer (log_task on core0)
+typedef struct
+{
+    log_record_t records[LOG_RING_SIZE];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t dropped;
+    uint32_t dropped_reported;
+} log_ring_t;
+
+static log_ring_t rings[2];
+
+static uint8_t record_size(const log_record_t* record) {
+    return sizeof(log_record_t) - (LOG_MAX_ARGS - record->arg_count) * sizeof(uint32_t);
+}
+
+void log_write(uint16_t id, uint32_t arg_count, const uint32_t* args) {
+    uint core = get_core_num();
+    log_ring_t* ring = &rings[core];
+    uint32_t head = ring->head;
+
+    if (head - ring->tail >= LOG_RING_SIZE) {
+        ring->dropped += 1;
+        return;
+    }
+
+    log_record_t* record = &ring->records[head % LOG_RING_SIZE];
+    record->time_us = time_us_32();
+    record->id = id;
+    record->core = core;
+    record->arg_count = arg_count;
+    for (uint32_t i = 0; i < arg_count; i++) { record->args[i] = args[i]; }
+
+    __dmb();
+    ring->head = head + 1;
+}
+
+// Low priority - called at the end of the core0 main loop.
+// Sends as many records as fit in the CDC buffer without waiting.
+void log_task() {
+    bool sent = false;
+
+    for (uint core = 0; core < 2; core++) {
+        log_ring_t* ring = &rings[core];
+
+        uint32_t dropped = ring->dropped;
+        if (dropped != ring->dropped_reported) {
+            log_record_t record = {
+                .time_us = time_us_32(), .id = LOG_DROPPED, .core = core, .arg_count = 2,
+                .args = { dropped - ring->dropped_reported, core }
+            };
+            if (!frame_send(FRAME_TYPE_LOG, &record, record_size(&record))) { break; }
+            ring->dropped_reported = dropped;
+            sent = true;
+        }
+
+        while (ring->tail != ring->head) {
+            __dmb();
+            log_record_t* record = &ring->records[ring->tail % LOG_RING_SIZE];
+            if (!frame_send(FRAME_TYPE_LOG, record, record_size(record))) { break; }
+            ring->tail += 1;
+            sent = true;
+        }
+    }
+
+    if (sent) {
+        tud_cdc_write_flush();
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef LOG_H__
+#define LOG_H__
+
+#include <stdint.h>
+
+// Binary logging - LOG(id, args...) stores id, timestamp and up to
+// LOG_MAX_ARGS 32 bit arguments in a per-core ring; log_task() on core0
+// sends them as FRAME_TYPE_LOG frames and python/log_decoder.py formats them.
+// Safe to call from thread code on either core (not from interrupt handlers).
+
+#define LOG_MAX_ARGS 4
+
+#define LOG_MESSAGE(id, format) id,
+enum {
+#include "log_messages.h"
+    LOG_MESSAGE_COUNT
+};
+#undef LOG_MESSAGE
+
+#define LOG_NARGS(...) LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+
+#define LOG(id, ...) log_write(id, LOG_NARGS(__VA_ARGS__), (const uint32_t[LOG_MAX_ARGS]){ __VA_ARGS__ })
+
+void log_write(uint16_t id, uint32_t arg_count, const uint32_t* args);
+
+static inline uint32_t log_f(float value) {
+    union { float f; uint32_t u; } v = { .f = value };
+    return v.u;
+}
+
+#endif /* LOG_H__ */
@@ -0,0 +1,74 @@
+// Log message formats, indexed by id. Only the id and arguments are sent,
+// python/log_decoder.py reads this file to format them on the host.
+// Append new messages at the end so ids of existing ones don't change.
+// Arguments are 32 bit; use %f with log_f() for floats.
+
+LOG_MESSAGE(LOG_I2C_PINS_NOT_DEFINED,       "Default I2C pins were not defined")
+LOG_MESSAGE(LOG_I2C_INITIATED,              "I2C Initiated")
+LOG_MESSAGE(LOG_INITIALISING,               "Initialising...")
+LOG_MESSAGE(LOG_STARTING_SECOND_CORE,       "Starting second core")
+LOG_MESSAGE(LOG_STARTED_SECOND_CORE,        "Started second core")
+LOG_MESSAGE(LOG_OVERRUN,                    "Overrun %i")
+LOG_MESSAGE(LOG_ANGLE,                      "Angle is %i")
+LOG_MESSAGE(LOG_KEY_DOWN,                   "Key %i down.")
+LOG_MESSAGE(LOG_KEY_PRESSED,                "Key %i pressed.")
+LOG_MESSAGE(LOG_KEY_LONG_PRESSED,           "Key %i long pressed.")
+LOG_MESSAGE(LOG_KEY_UP,                     "Key %i up.")
+LOG_MESSAGE(LOG_KEY_RELEASED,               "Key %i released.")
+LOG_MESSAGE(LOG_MENU_STARTED,               "Menu started, bank %i")
+LOG_MESSAGE(LOG_MENU_NEXT,                  "Menu next, bank %i")
+LOG_MESSAGE(LOG_MENU_FINISHED,              "Menu finished, bank %i")
+LOG_MESSAGE(LOG_USB_MOUNTED,                "Mounted...")
+LOG_MESSAGE(LOG_USB_UNMOUNTED,              "Unmounted...")
+LOG_MESSAGE(LOG_USB_SUSPENDED,              "Suspended...")
+LOG_MESSAGE(LOG_USB_RESUMED,                "Resumed...")
+LOG_MESSAGE(LOG_MSC_READ,                   "Received read lba=%i, offset=%i")
+LOG_MESSAGE(LOG_MSC_WRITE,                  "Received write lba=%i, offset=%i")
+LOG_MESSAGE(LOG_MSC_PROFILE_RECEIVED,       "Received profile %i with size %i")
+LOG_MESSAGE(LOG_MSC_PROFILE_INT_VALUES,     "direction=%i, dividers=%i")
+LOG_MESSAGE(LOG_MSC_PROFILE_FLOAT_VALUES,   "expo=%f, gain=%f, dead_band=%f")
+LOG_MESSAGE(LOG_MSC_PROFILE_SELECTED,       "Selected profile %i")
+LOG_MESSAGE(LOG_MSC_TASK_MAX_TIME,          "msc_task max time %ius")
+LOG_MESSAGE(LOG_PROFILES_BIN_BAD_HEADER,    "ERROR: PROFILES.BIN bad header")
+LOG_MESSAGE(LOG_PROFILES_BIN_BAD_VERSION,   "ERROR: PROFILES.BIN version %i not supported")
+LOG_MESSAGE(LOG_PROFILES_BIN_BAD_CRC,       "ERROR: PROFILES.BIN bad crc")
+LOG_MESSAGE(LOG_PROFILES_BIN_RECEIVED,      "Received PROFILES.BIN with %i profiles")
+LOG_MESSAGE(LOG_NEOKEY_HW_ID_ERROR,         "Neokey board 0x%02x not found: %i")
+LOG_MESSAGE(LOG_NEOKEY_HW_ID_READ_ERROR,    "ERROR: neokey_init(hd id read) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_VERSION_ERROR,       "ERROR: neokey_init(ver) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_VERSION_READ_ERROR,  "ERROR: neokey_init(ver read) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_PIN_ERROR,           "ERROR: neokey_init(neopixel pin) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_BUF_LEN_ERROR,       "ERROR: neokey_init(neopixel buf len) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_DIRCLR_ERROR,        "ERROR: neokey_init(gpio dirclr) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_PULLENSET_ERROR,     "ERROR: neokey_init(gpio pullenset) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_BULKSET_ERROR,       "ERROR: neokey_init(gpio bulkset) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_INTENSET_ERROR,      "ERROR: neokey_init(gpio intenset) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_VERSION,             "Neokey chip_id %i, version %i, (%i, %i)")
+LOG_MESSAGE(LOG_NEOKEY_INITIALISED,         "Neokey board 0x%02x initialised, keypad fifo %i")
+LOG_MESSAGE(LOG_NEOKEY_WRITE_LEDS_ERROR,    "ERROR: write_leds 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_SHOW_LEDS_ERROR,     "ERROR: write_leds (show) 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_READ_KEYS_WRITE_ERROR, "ERROR: read_keys_raw write 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_READ_KEYS_READ_ERROR,  "ERROR: read_keys_raw read 0x%02x: %i")
+LOG_MESSAGE(LOG_DROPPED,                    "Log dropped %i records on core %i")
+LOG_MESSAGE(LOG_NEOKEY_KEYPAD_ERROR,       "ERROR: neokey_init(keypad event) 0x%02x: %i, using gpio polling")
+LOG_MESSAGE(LOG_NEOKEY_KEYPAD_COUNT_ERROR, "ERROR: read_keys_raw keypad count 0x%02x: %i")
+LOG_MESSAGE(LOG_NEOKEY_KEYPAD_FIFO_ERROR,  "ERROR: read_keys_raw keypad fifo 0x%02x: %i")
+LOG_MESSAGE(LOG_GESTURE,                    "Gesture %i key %i action %08x")
+LOG_MESSAGE(LOG_I2C_UTILISATION,            "I2C device %i busy %i/1000, %i transfers, %i errors")
+LOG_MESSAGE(LOG_I2C_JOBS,                   "I2C jobs deferred %i times, longest %i us")
+LOG_MESSAGE(LOG_NEOKEY_RECOVERED,           "Neokey board 0x%02x recovered after %i attempts")
+LOG_MESSAGE(LOG_SCHEDULER_TASK,             "Task %i ran %i times, busy %i/1000, longest %i us")
+LOG_MESSAGE(LOG_SCHEDULER_IDLE,             "Core0 idle %i/1000, %i sleeps")
+LOG_MESSAGE(LOG_BOOT_PHASE,                 "Boot phase %i at %i us")
+LOG_MESSAGE(LOG_PWM_CONFIGURED,             "PWM carrier %i Hz, %i steps")
+LOG_MESSAGE(LOG_CURRENT_CALIBRATED,         "Current sense zero at %i counts")
+LOG_MESSAGE(LOG_CALIBRATION_LOADED,         "Sensor calibration loaded")
+LOG_MESSAGE(LOG_CALIBRATION_MISSING,        "No sensor calibration, using raw angle and default zero")
+LOG_MESSAGE(LOG_CALIBRATION_STARTED,        "Sensor calibration started")
+LOG_MESSAGE(LOG_CALIBRATION_FAILED,         "ERROR: sensor calibration failed: %i (%i)")
+LOG_MESSAGE(LOG_CALIBRATION_DONE,           "Sensor calibrated from %i samples over %i turns, 1st harmonic %f, 2nd %f counts")
+LOG_MESSAGE(LOG_CALIBRATION_ZERO,           "Sensor zero set at %i counts")
+LOG_MESSAGE(LOG_CALIBRATION_SAVED,          "Sensor calibration saved")
+LOG_MESSAGE(LOG_SENSOR_FAULTS,              "AS5600 faults: %i i2c errors, %i no magnet, %i weak/strong magnet, %i coasts")
+LOG_MESSAGE(LOG_SENSOR_CONFIGURED,          "AS5600 filter %i, fast threshold %i, hysteresis %i, oversample %i")
+LOG_MESSAGE(LOG_MSC_WRITES_APPLIED,         "Applied %i MSC writes, longest %i us, HID report latency up to %i us")
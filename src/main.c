@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include "pico/stdlib.h"
 #include "pico/binary_info.h"
 #include "hardware/i2c.h"
@@ -7,6 +8,14 @@
 #include "joystick_hid.h"
 #include "profile.h"
 #include "neokey.h"
+#include "log.h"
+#include "telemetry.h"
+#include "led_animation.h"
+#include "gestures.h"
+#include "i2c_bus.h"
+#include "scheduler.h"
+#include "boot.h"
+#include "sensor.h"
 
 
 #define DEBUG_ANGLE 0
@@ -28,29 +37,14 @@ enum  {
 enum {
     STATE_BOOTING = 0,
     STATE_INITIALISE,
-    STATE_START_SECOND_CORE,
-    STATE_PREPARE_TO_RUN,
-    STATE_DELAY_RUNNING,
+    STATE_PROBE_SENSOR,
     STATE_RUNNING,
     STATE_STOPPED,
 };
 
-enum {
-    MOUSE_LEFT_BUTTON = 0,
-    MOUSE_RIGHT_BUTTON,
-    MOUSE_MIDDLE_BUTTON,
-    MOUSE_WHEEL_X,
-    MOUSE_WHEEL_Y,
-};
 
-enum {
-    JOYSTICK_AXIS_0 = 0,
-    JOYSTICK_AXIS_1,
-    JOYSTICK_AXIS_2,
-};
-
-
-volatile int16_t angle = 0;
+volatile int16_t angle = -1;
+volatile uint8_t angle_status = 0;
 volatile int16_t last_angle = -1;
 
 extern void neokey_init();
@@ -67,47 +61,85 @@ extern uint32_t overrun_millis;
 
 
 extern void start_second_core();
-extern void process_keys(uint32_t now);
-extern int get_key_state(uint32_t key_num);
+extern bool angle_sensor_ready();
+extern bool get_key_event(key_event_t* event);
 extern void set_profile(uint32_t selected_profile_number);
-
-extern uint8_t leds[12];
+extern void msc_task();
+extern void log_task();
+extern bool telemetry_snapshot(telemetry_t* sample);
+extern void telemetry_stream_task();
+extern void cdc_task();
+extern void calibration_load();
+extern void calibration_task();
+extern void calibration_set_zero();
+
+extern void led_animation_init();
+extern void led_animation_task();
+extern void led_set_base(int key, uint8_t r, uint8_t g, uint8_t b);
+extern void led_set_breathing(uint16_t keys);
+extern void led_tick();
+extern void led_set_velocity(float velocity);
+extern void led_set_error(uint8_t code);
+
+extern void gestures_key_event(uint8_t key, uint8_t event, uint32_t time);
+extern void gestures_cancel(uint8_t key);
+extern void gestures_wheel(int32_t detents);
+extern bool gestures_wheel_alt();
+extern void gestures_task();
+extern void hid_action_angle(key_action_t action, int16_t angle);
+extern void hid_actions_task();
+extern bool flywheel_enabled();
+extern volatile int32_t flywheel_steps;
+extern int32_t accel_apply(int32_t detents, float velocity);
+
+extern int scheduler_add_task(void (*fn)(), uint8_t priority, uint32_t period_ms, uint8_t wake_mask, bool enabled);
+extern void scheduler_enable(int task, bool enable);
+extern void scheduler_set_period(int task, uint32_t period_ms);
+extern void scheduler_run();
+
+_Static_assert(NEOKEY_MAX_KEYS <= PROFILE_KEY_COUNT, "Not enough key actions in profile_t for all Neokey keys");
 
 const uint32_t direction = 1;
-const float zero = 235.0;
 
-profile_t profiles[9] = {
+profile_t profiles[PROFILE_COUNT] = {
     {
-        .direction = direction, .zero = zero, .dividers = 1, .expo = -0.9, .gain_factor = 2, .dead_band = 0.4, .full_resolution = 1,
+        .direction = direction, .dividers = 1, .expo = -0.9, .gain_factor = 2, .dead_band = 0.4, .full_resolution = 1,
+        // Free spinning - least sensor delay
+        .sensor_filter = 3,
         .wheel_main = { .type = REPORT_ID_MOUSE, .sub_type = MOUSE_WHEEL_Y },
         .wheel_alt = { .type = REPORT_ID_MOUSE, .sub_type = MOUSE_WHEEL_X },
-        .key1 = { .type = REPORT_ID_MOUSE, .sub_type = MOUSE_RIGHT_BUTTON },
-        .key2 = { .type = REPORT_ID_KEYBOARD, .value = HID_KEY_ESCAPE },
-        .key3 = { .type = REPORT_ID_JOYSTICK, .value = JOYSTICK_AXIS_0 },
+        .keys = {
+            { .type = REPORT_ID_MOUSE, .sub_type = MOUSE_RIGHT_BUTTON },
+            { .type = REPORT_ID_KEYBOARD, .value = HID_KEY_ESCAPE },
+            { .type = REPORT_ID_JOYSTICK, .value = JOYSTICK_AXIS_0 },
+        },
     },
     {
-        .direction = direction, .zero = zero, .dividers = 8, .expo = -0.25, .gain_factor = 1, .dead_band = 0.4, .full_resolution = 0,
+        .direction = direction, .dividers = 8, .expo = -0.25, .gain_factor = 1, .dead_band = 0.4, .full_resolution = 0,
     },
     {
-        .direction = direction, .zero = zero, .dividers = 16, .expo = 0.9, .gain_factor = 1, .dead_band = 0.4, .full_resolution = 0,
+        .direction = direction, .dividers = 16, .expo = 0.9, .gain_factor = 1, .dead_band = 0.4, .full_resolution = 0,
     },
     {
-        .direction = direction, .zero = zero, .dividers = 32, .expo = -0.8, .gain_factor = 0.5, .dead_band = 0.8, .full_resolution = 1,
+        .direction = direction, .dividers = 32, .expo = -0.8, .gain_factor = 0.5, .dead_band = 0.8, .full_resolution = 1,
     },
     {
-        .direction = direction, .zero = zero, .dividers = 12, .expo = -0.9, .gain_factor = 1, .dead_band = 0.8,
+        .direction = direction, .dividers = 12, .expo = -0.9, .gain_factor = 1, .dead_band = 0.8,
     },
     {
-        .direction = direction, .zero = zero, .dividers = 24, .expo = -0.8, .gain_factor = 1, .dead_band = 0.4,
+        .direction = direction, .dividers = 24, .expo = -0.8, .gain_factor = 1, .dead_band = 0.4,
     },
     {
-        .direction = direction, .zero = zero, .dividers = 32, .expo = 0.9, .gain_factor = 1, .dead_band = 0.4,
+        .direction = direction, .dividers = 32, .expo = 0.9, .gain_factor = 1, .dead_band = 0.4,
     },
     {
-        .direction = direction, .zero = zero, .dividers = 48, .expo = 0.9, .gain_factor = 1, .dead_band = 0.4,
+        .direction = direction, .dividers = 48, .expo = 0.9, .gain_factor = 1, .dead_band = 0.4,
+        // Fine detents - least noise, fast filter still takes over on quick turns
+        .sensor_filter = 0, .sensor_fast_threshold = 7, .sensor_hysteresis = 1, .sensor_oversample = 3,
     },
     {
-        .direction = direction, .zero = zero, .dividers = 48, .expo = -0.8, .gain_factor = 0.5, .dead_band = 0.8,
+        .direction = direction, .dividers = 48, .expo = -0.8, .gain_factor = 0.5, .dead_band = 0.8,
+        .sensor_filter = 0, .sensor_fast_threshold = 7, .sensor_hysteresis = 1, .sensor_oversample = 3,
     },
 };
 
@@ -120,8 +152,12 @@ static uint32_t last_button = 0;
 static uint32_t btn = false;
 static uint16_t initialise_state = STATE_BOOTING;
 
+#define RUNNING_TASK_COUNT 3
+static int startup_task_id = -1;
+static int blink_task_id = -1;
+static int running_task_ids[RUNNING_TASK_COUNT];
+
 static uint8_t key_event[4] = {0, 0, 0};
-static bool alt_invoked = 0;
 
 
 enum {
@@ -132,6 +168,10 @@ enum {
 };
 
 static int keys_state = KEYS_STATE_WORKING;
+// Menu key went down while in the menu - holding it sets the zero
+static bool menu_key_in_menu = false;
+
+static uint8_t profile_cursor = 0;
 
 void led_blinking_task();
 void hid_task();
@@ -139,34 +179,34 @@ void hid_task();
 void local_i2c_init() {
   #if !defined(i2c_default) || !defined(PICO_DEFAULT_I2C_SDA_PIN) || !defined(PICO_DEFAULT_I2C_SCL_PIN)
   #warning i2c/bus_scan example requires a board with I2C pins
-    printf("Default I2C pins were not defined\n");
+    LOG(LOG_I2C_PINS_NOT_DEFINED);
   #else
-    i2c_init(i2c_default, 100 * 1000);
+    i2c_init(i2c_default, I2C_BUS_BAUDRATE);
     gpio_set_function(PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C);
     gpio_set_function(PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C);
     gpio_pull_up(PICO_DEFAULT_I2C_SDA_PIN);
     gpio_pull_up(PICO_DEFAULT_I2C_SCL_PIN);
     bi_decl(bi_2pins_with_func(PICO_DEFAULT_I2C_SDA_PIN, PICO_DEFAULT_I2C_SCL_PIN, GPIO_FUNC_I2C));
 
-    printf("\nI2C Initiated\n");
+    LOG(LOG_I2C_INITIATED);
   #endif
 }
 
-void set_alt_invoked()
-
 bool reserved_addr(uint8_t addr) {
     return (addr & 0x78) == 0 || (addr & 0x78) == 0x78;
 }
 
 void set_leds(int i, uint8_t r, uint8_t g, uint8_t b) {
-    i = 3 - i;
-    leds[i * 3] = g;
-    leds[i * 3 + 1] = r;
-    leds[i * 3 + 2] = b;
+    led_set_base(i, r, g, b);
 }
 
 void set_leds_to_selected_profile() {
+    // Keys on additional boards don't take part in the menu
+    for (int i = NEOKEY_KEYS_PER_BOARD; i < NEOKEY_MAX_KEYS; i++) {
+        set_leds(i, 0, 0, 0);
+    }
     if (keys_state < KEYS_STATE_WORKING) {
+        led_set_breathing((1 << NEOKEY_KEYS_PER_BOARD) - 1);
         if (keys_state == KEYS_STATE_MENU_PROFILE_SELECT_BANK_0) {
             set_leds(0, 32, 0, 0);
             set_leds(1, 32, 32, 0);
@@ -182,6 +222,7 @@ void set_leds_to_selected_profile() {
         }
         set_leds(3, 32, 16, 0);
     } else {
+        led_set_breathing(0);
         set_leds(0, 0, 0, 0);
         set_leds(1, 0, 0, 0);
         set_leds(2, 0, 0, 0);
@@ -228,7 +269,7 @@ void set_leds_to_selected_profile() {
     }
 }
 
-void keys_task(uint32_t now) {
+void keys_task() {
     #if (DEBUG_BUTTON_STATE)
         if (last_buttons_state != buttons_state
             || last_buttons[0] != buttons[0]
@@ -240,68 +281,82 @@ void keys_task(uint32_t now) {
             for (int i = 0; i < 4; i++) { last_buttons[i] = buttons[i]; }
         }
     #endif
-    process_keys(now);
 
-    for (int i = 0; i < 4; i++) {
-        int key_no = 3 - i;
-        int key_state = get_key_state(i);
-        switch (key_state) {
+    key_event_t event;
+    while (get_key_event(&event)) {
+        int key_no = NEOKEY_KEY_NO(event.key);
+        switch (event.event) {
             case (KEY_DOWN): {
                 #if (DEBUG_KEYS)
-                printf("Key %d down.\n", key_no);
+                LOG(LOG_KEY_DOWN, key_no);
                 #endif
                 set_leds(key_no, 32, 32, 32);
             }
             break;
             case (KEY_PRESSED): {
                 #if (DEBUG_KEYS)
-                printf("Key %d pressed.\n", key_no);
+                LOG(LOG_KEY_PRESSED, key_no);
                 #endif
                 set_leds(key_no, 32, 32, 0);
                 if (keys_state < KEYS_STATE_WORKING) {
                     if (key_no < 3) {
                         set_profile(key_no + keys_state * 3);
                         keys_state = KEYS_STATE_WORKING;
-                    } else {
+                    } else if (key_no == 3) {
                         keys_state += 1;
+                        menu_key_in_menu = true;
                     }
                     if (keys_state == KEYS_STATE_WORKING) {
                         #if (DEBUG_MENU)
-                        printf("Menu finished, bank %i\n", keys_state);
+                        LOG(LOG_MENU_FINISHED, keys_state);
                         #endif
                     } else {
                         #if (DEBUG_MENU)
-                        printf("Menu next, bank %i\n", keys_state);
+                        LOG(LOG_MENU_NEXT, keys_state);
                         #endif
                     }
                     set_leds_to_selected_profile();
+                } else {
+                    gestures_key_event(key_no, event.event, event.time);
                 }
             }
             break;
             case (KEY_LONG_PRESSED): {
                 #if (DEBUG_KEYS)
-                printf("Key %d long pressed.\n", key_no);
+                LOG(LOG_KEY_LONG_PRESSED, key_no);
                 #endif
-                if (key_no == 3) {
+                if (key_no == 3 && menu_key_in_menu) {
+                    calibration_set_zero();
+                    keys_state = KEYS_STATE_WORKING;
+                    #if (DEBUG_MENU)
+                    LOG(LOG_MENU_FINISHED, keys_state);
+                    #endif
+                    set_leds_to_selected_profile();
+                } else if (key_no == 3) {
+                    gestures_cancel(key_no);
                     keys_state = KEYS_STATE_MENU_PROFILE_SELECT_BANK_0;
                     #if (DEBUG_MENU)
-                    printf("Menu started, bank %i\n", keys_state);
+                    LOG(LOG_MENU_STARTED, keys_state);
                     #endif
                     set_leds_to_selected_profile();
+                } else if (keys_state == KEYS_STATE_WORKING) {
+                    gestures_key_event(key_no, event.event, event.time);
                 }
             }
             break;
             case (KEY_UP): {
                 #if (DEBUG_KEYS)
-                printf("Key %d up.\n", key_no);
+                LOG(LOG_KEY_UP, key_no);
                 #endif
                 set_leds_to_selected_profile();
             }
             break;
             case (KEY_RELEASED): {
                 #if (DEBUG_KEYS)
-                printf("Key %d released.\n", key_no);
+                LOG(LOG_KEY_RELEASED, key_no);
                 #endif
+                if (key_no == 3) { menu_key_in_menu = false; }
+                gestures_key_event(key_no, event.event, event.time);
                 set_leds_to_selected_profile();
             }
             break;
@@ -310,78 +365,242 @@ void keys_task(uint32_t now) {
     }
 }
 
-int main() {
-    board_init();
-    tusb_init();
-    stdio_init_all();
+// Detents passed since last call go to the gestures (wheel actions), scaled by the
+// profile acceleration curve, and LED ticks; in flywheel mode the flywheel's steps
+// instead - the flywheel carries fast spins on its own
+void wheel_task() {
+    static int32_t last_detent = -1;
+    static int32_t last_flywheel_steps = 0;
+
+    int32_t steps = flywheel_steps;
+    if (flywheel_enabled()) {
+        if (steps != last_flywheel_steps) {
+            gestures_wheel(steps - last_flywheel_steps);
+            led_tick();
+        }
+        last_flywheel_steps = steps;
+        last_detent = -1;
+        return;
+    }
+    last_flywheel_steps = steps;
 
-    initialise_state = STATE_INITIALISE;
+    if (!(angle_status & SENSOR_VALID)) {
+        last_detent = -1;
+        return;
+    }
 
-    uint32_t next_event = board_millis() + 2000;
-    while (true) {
-        uint32_t const now = board_millis();
+    int32_t dividers = profiles[selected_profile].dividers;
+    int32_t detent = angle * dividers / 360;
+    if (last_detent >= 0 && detent != last_detent) {
+        int32_t detents = detent - last_detent;
+        if (detents > dividers / 2) {
+            detents -= dividers;
+        } else if (detents < -dividers / 2) {
+            detents += dividers;
+        }
+        telemetry_t telemetry;
+        if (telemetry_snapshot(&telemetry)) {
+            detents = accel_apply(detents, telemetry.velocity);
+        }
+        if (detents != 0) {
+            gestures_wheel(detents);
+        }
+        led_tick();
+    }
+    last_detent = detent;
+}
+
+// Feeds wheel state to the LED animations: speed for the status key colour and error blink codes.
+void led_status_task() {
+    static uint32_t overrun_at = 0;
+    static bool overrun_seen = false;
+
+    uint32_t now = board_millis();
+    if (overrun_millis != 0) {
+        overrun_at = now;
+        overrun_seen = true;
+    }
+    if (overrun_seen && now - overrun_at > 2000) {
+        overrun_seen = false;
+    }
+
+    uint8_t status = angle_status;
+    if (status & (SENSOR_MAGNET_MISSING | SENSOR_MAGNET_WEAK | SENSOR_MAGNET_STRONG)) {
+        led_set_error(LED_ERROR_MAGNET);
+        return;
+    }
+    if (!(status & SENSOR_VALID)) {
+        led_set_error(LED_ERROR_SENSOR);
+        return;
+    }
+    led_set_error(overrun_seen ? LED_ERROR_OVERRUN : LED_ERROR_NONE);
+
+    telemetry_t telemetry;
+    if (telemetry_snapshot(&telemetry)) {
+        led_set_velocity(telemetry.velocity);
+    }
+}
 
-        tud_task();
-        led_blinking_task();
+// Brings the device up as soon as the hardware answers: the angle sensor is
+// probed every BOOT_SENSOR_PROBE_PERIOD, then Neokey boards are initialised
+// (the ones that don't answer are left to background recovery) and core1 starts.
+void startup_task() {
+    static uint32_t probe_started_at = 0;
+    uint32_t now = board_millis();
 
-        if (initialise_state == STATE_INITIALISE && now > next_event) {
-            printf("\033c\033[2J\033[;HInitialising...\n");
-            next_event = now + 100;
-            initialise_state = STATE_STOPPED;
-            initialise_state = STATE_START_SECOND_CORE;
+    switch (initialise_state) {
+        case (STATE_INITIALISE): {
+            LOG(LOG_INITIALISING);
             local_i2c_init();
-            neokey_init();
-            set_leds(0, 0x20, 0, 0);
-            set_leds(1, 0x20, 0x20, 0);
-            set_leds(2, 0, 0x20, 0);
-            set_leds(3, 0, 0x20, 0x20);
+            LOG(LOG_BOOT_PHASE, BOOT_PHASE_I2C, time_us_32());
+            probe_started_at = now;
+            initialise_state = STATE_PROBE_SENSOR;
         }
-        if (initialise_state == STATE_START_SECOND_CORE && now > next_event) {
+        // fall through
+        case (STATE_PROBE_SENSOR): {
+            bool sensor_ready = angle_sensor_ready();
+            if (!sensor_ready && now - probe_started_at < BOOT_SENSOR_PROBE_TIMEOUT) { break; }
+            LOG(LOG_BOOT_PHASE, sensor_ready ? BOOT_PHASE_SENSOR : BOOT_PHASE_SENSOR_TIMEOUT, time_us_32());
+
+            neokey_init();
+            LOG(LOG_BOOT_PHASE, BOOT_PHASE_KEYPAD, time_us_32());
+
             start_second_core();
-            next_event = now + 100;
-            initialise_state = STATE_PREPARE_TO_RUN;
-        }
-        if (initialise_state == STATE_PREPARE_TO_RUN && now > next_event) {
-            initialise_state = STATE_DELAY_RUNNING;
-            next_event = now + 2000;
-        }
-        if (initialise_state == STATE_DELAY_RUNNING && now > next_event) {
+            LOG(LOG_BOOT_PHASE, BOOT_PHASE_CORE1, time_us_32());
+
             set_leds_to_selected_profile();
             initialise_state = STATE_RUNNING;
+            scheduler_enable(startup_task_id, false);
+            for (int i = 0; i < RUNNING_TASK_COUNT; i++) { scheduler_enable(running_task_ids[i], true); }
         }
-        if (initialise_state == STATE_RUNNING) {
-            keys_task(now);
-
-            #if (DEBUG_ANGLE)
-                if (now >= next_report) {
-                    next_report = now + 2000;
-                    if (last_angle != angle) {
-                        printf("Angle is %i\n", angle);
-                        last_angle = angle;
-                    }
-                }
-            #endif
-
-            hid_task();
+        break;
+        default: break;
+    }
+}
 
-            if (overrun_millis != 0) {
-                printf("Overrun %i  ", overrun_millis);
-                overrun_millis = 0;
+void input_task() {
+    #if (DEBUG_ANGLE)
+        uint32_t const now = board_millis();
+        if (now >= next_report) {
+            next_report = now + 2000;
+            if (last_angle != angle) {
+                LOG(LOG_ANGLE, angle);
+                last_angle = angle;
             }
         }
+    #endif
+
+    wheel_task();
+    hid_task();
+}
+
+void status_task() {
+    led_status_task();
+
+    if (overrun_millis != 0) {
+        LOG(LOG_OVERRUN, overrun_millis);
+        overrun_millis = 0;
     }
 }
 
+int main() {
+    board_init();
+    tusb_init();
+    stdio_init_all();
+    led_animation_init();
+    calibration_load();
+
+    const uint8_t usb = SCHEDULER_WAKE(SCHEDULER_WAKE_USB);
+    const uint8_t keys = SCHEDULER_WAKE(SCHEDULER_WAKE_KEYS);
+    const uint8_t core1 = SCHEDULER_WAKE(SCHEDULER_WAKE_CORE1);
+
+    scheduler_add_task(tud_task, SCHEDULER_PRIORITY_USB, 10, usb, true);
+    blink_task_id = scheduler_add_task(led_blinking_task, SCHEDULER_PRIORITY_BACKGROUND, blink_interval_ms, 0, true);
+    startup_task_id = scheduler_add_task(startup_task, SCHEDULER_PRIORITY_INPUT, BOOT_SENSOR_PROBE_PERIOD, 0, true);
+
+    // Run once the second core is up. Keys go first so gestures see their events in the same pass.
+    running_task_ids[0] = scheduler_add_task(keys_task, SCHEDULER_PRIORITY_INPUT, 10, keys, false);
+    running_task_ids[1] = scheduler_add_task(input_task, SCHEDULER_PRIORITY_INPUT, 5, keys | core1 | usb, false);
+    running_task_ids[2] = scheduler_add_task(status_task, SCHEDULER_PRIORITY_OUTPUT, LED_FRAME_PERIOD, 0, false);
+
+    scheduler_add_task(led_animation_task, SCHEDULER_PRIORITY_OUTPUT, LED_FRAME_PERIOD, 0, true);
+    scheduler_add_task(cdc_task, SCHEDULER_PRIORITY_BACKGROUND, 10, usb, true);
+    scheduler_add_task(telemetry_stream_task, SCHEDULER_PRIORITY_BACKGROUND, 10, core1, true);
+    scheduler_add_task(msc_task, SCHEDULER_PRIORITY_BACKGROUND, 10, usb, true);
+    scheduler_add_task(log_task, SCHEDULER_PRIORITY_BACKGROUND, 10, core1, true);
+    scheduler_add_task(calibration_task, SCHEDULER_PRIORITY_BACKGROUND, 100, 0, true);
+
+    initialise_state = STATE_INITIALISE;
+    LOG(LOG_BOOT_PHASE, BOOT_PHASE_SCHEDULER, time_us_32());
+    scheduler_run();
+}
 
 #include "tusb.h"
 
+//--------------------------------------------------------------------+
+// HID feature reports - configuration and telemetry
+//--------------------------------------------------------------------+
+
 uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id,
          hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen) {
+    (void) instance;
+
+    if (report_type != HID_REPORT_TYPE_FEATURE) { return 0; }
+
+    switch (report_id) {
+        case (REPORT_ID_CONFIG): {
+            if (reqlen < 2) { return 0; }
+            buffer[0] = selected_profile;
+            buffer[1] = profile_cursor;
+            return 2;
+        }
+        case (REPORT_ID_PROFILE): {
+            if (reqlen < 1 + sizeof(profile_t)) { return 0; }
+            buffer[0] = profile_cursor;
+            memcpy(buffer + 1, &profiles[profile_cursor], sizeof(profile_t));
+            return 1 + sizeof(profile_t);
+        }
+        case (REPORT_ID_TELEMETRY): {
+            telemetry_t telemetry;
+            if (reqlen < sizeof(telemetry_t) || !telemetry_snapshot(&telemetry)) { return 0; }
+            memcpy(buffer, &telemetry, sizeof(telemetry_t));
+            return sizeof(telemetry_t);
+        }
+        default: break;
+    }
+    return 0;
 }
 
 void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id,
          hid_report_type_t report_type, uint8_t const* buffer,
          uint16_t bufsize) {
+    (void) instance;
+
+    if (report_type != HID_REPORT_TYPE_FEATURE) { return; }
+
+    switch (report_id) {
+        case (REPORT_ID_CONFIG): {
+            if (bufsize < 2) { return; }
+            if (buffer[1] < PROFILE_COUNT) {
+                profile_cursor = buffer[1];
+            }
+            if (buffer[0] < PROFILE_COUNT && buffer[0] != selected_profile) {
+                set_profile(buffer[0]);
+                set_leds_to_selected_profile();
+            }
+        }
+        break;
+        case (REPORT_ID_PROFILE): {
+            if (bufsize < 1 + sizeof(profile_t) || buffer[0] >= PROFILE_COUNT) { return; }
+            profile_cursor = buffer[0];
+            memcpy(&profiles[profile_cursor], buffer + 1, sizeof(profile_t));
+            if (profile_cursor == selected_profile) {
+                set_profile(profile_cursor);
+            }
+        }
+        break;
+        default: break;
+    }
 }
 
 //--------------------------------------------------------------------+
@@ -392,14 +611,14 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id,
 void tud_mount_cb(void)
 {
   blink_interval_ms = BLINK_MOUNTED;
-  printf("Mounted...");
+  LOG(LOG_USB_MOUNTED);
 }
 
 // Invoked when device is unmounted
 void tud_umount_cb(void)
 {
   blink_interval_ms = BLINK_NOT_MOUNTED;
-  printf("Unmounted...");
+  LOG(LOG_USB_UNMOUNTED);
 }
 
 // Invoked when usb bus is suspended
@@ -409,83 +628,43 @@ void tud_suspend_cb(bool remote_wakeup_en)
 {
   (void) remote_wakeup_en;
   blink_interval_ms = BLINK_SUSPENDED;
-  printf("Suspended...");
+  LOG(LOG_USB_SUSPENDED);
 }
 
 // Invoked when usb bus is resumed
 void tud_resume_cb(void)
 {
   blink_interval_ms = BLINK_MOUNTED;
-  printf("Resumed...");
+  LOG(LOG_USB_RESUMED);
 }
 
 //--------------------------------------------------------------------+
 // USB HID
 //--------------------------------------------------------------------+
 
-static void send_joystick_hid_report() {
-
-    hid_joystick_report_t report = {
-        .x = 0, .y = 0, .z = 0,
-        .buttons = 0
-    };
-
-
-    switch (profiles[selected_profile].wheel_main.value) {
-        case 0: {
-            report.x = angle;
-        }
-        break;
-        case 1: {
-            report.y = angle;
-        }
-        break;
-        case 2: {
-            report.z = angle;
-        }
-        break;
-
-        default: break;
-    }
-    tud_hid_report(REPORT_ID_JOYSTICK, &report, sizeof(report));
-}
-
+// Wheel actions that are not joystick axes go out per detent from wheel_task()
 void hid_task() {
-    const uint32_t interval_ms = 10;
-    static uint32_t start_ms = 0;
     static int16_t previous_angle = -1;
-    static uint32_t first_time = true;
-
-    if (board_millis() - start_ms < interval_ms) { return; }
-    start_ms += interval_ms;
 
-    if (!tud_hid_ready()) { return; }
+    gestures_task();
 
-    if (previous_angle != angle) {
-        send_joystick_hid_report();
+    if (angle >= 0 && previous_angle != angle) {
+        const profile_t* profile = &profiles[selected_profile];
+        hid_action_angle(gestures_wheel_alt() ? profile->wheel_alt : profile->wheel_main, angle);
         previous_angle = angle;
     }
 
-    if (first_time) {
-        // blink_interval_ms = BLINK_CONNECTED;
-        first_time = false;
-    }
+    hid_actions_task();
 }
 
 //--------------------------------------------------------------------+
 // BLINKING TASK
 //--------------------------------------------------------------------+
 void led_blinking_task() {
-  static uint32_t start_ms = 0;
   static bool led_state = false;
 
-  if (!blink_interval_ms) return;
-
-  if (board_millis() - start_ms < blink_interval_ms) { return; }
-  start_ms += blink_interval_ms;
+  scheduler_set_period(blink_task_id, blink_interval_ms);
 
   board_led_write(led_state);
   led_state = 1 - led_state;
 }
-
-void set_alt_invoked
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef MOTOR_H__
+#define MOTOR_H__
+
+// H-bridge output stage (TB6612 style: AIN1, AIN2 and PWM). Both inputs sit on
+// the two channels of one PWM slice running with the PWM pin's carrier, so each
+// bridge state is just a set of levels:
+//   slow decay - inputs hold the direction, the PWM pin pulses; off-time shorts
+//                the winding (brake), torque follows the duty less the back-EMF
+//   fast decay - PWM pin high, the direction input pulses; off-time turns the
+//                bridge off and the current returns to the supply. Weak at low
+//                duty, but never brakes
+//   coast      - both inputs low, bridge off
+// With MOTOR_DECAY_AUTO run_cycle() picks one every cycle from the tension and
+// the velocity: coast when no tension is asked for, so a free wheel or a lost
+// sensor doesn't drag; fast decay when pushing with the hand by less than the
+// back-EMF, where slow decay would brake against the push; slow decay
+// otherwise - linear at low speed, and against the hand the back-EMF adds to
+// the braking for sharp end-stops. With 0 it is slow decay always.
+// Checked with python/simulator.py.
+#define MOTOR_DECAY_AUTO 1
+
+enum {
+    MOTOR_SLOW_DECAY = 0,
+    MOTOR_FAST_DECAY,
+    MOTOR_COAST,
+};
+
+// Percent, below this the bridge is let go
+#define MOTOR_COAST_TENSION 0.5
+// Back-EMF as tension percent per degree/s
+#define MOTOR_BACK_EMF 0.0035
+
+#endif /* MOTOR_H__ */
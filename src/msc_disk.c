@@ -24,17 +24,20 @@
  */
 
 #include "bsp/board.h"
+#include "pico/stdlib.h"
 #include "pico/bootrom.h"
 #include "tusb.h"
 #include "profile.h"
 #include "nxjson.h"
+#include "log.h"
 
 // #define DEBUG_MSC = 1
 
 extern void set_profile(uint32_t selected_profile_number);
+extern uint32_t crc32(const uint8_t* data, size_t len);
 
 extern volatile int16_t angle;
-extern profile_t profiles[9];
+extern profile_t profiles[PROFILE_COUNT];
 extern uint32_t selected_profile;
 
 static bool ejected = false;
@@ -51,9 +54,9 @@ Files: \n\
     Read to see selected profile\n\
 - PROFILEx.TXT - JSON for profile 'x' (x in 1-9)\n\
     Write to it to override existing values.\n\
+- PROFILES.BIN - all profiles in one binary file\n\
 - ANGLE.TXT    - Current position of the wheel\n\
-    Note: filesystem is cached so it doesn't\n\
-    really represent current value\n\
+    Note: cached by the host, may be stale\n\
 "
 #define README_CONTENTS_SIZE_L (sizeof(README_CONTENTS) - 1) & 0xFF
 #define README_CONTENTS_SIZE_H ((sizeof(README_CONTENTS) - 1) & 0xFF00) >> 8
@@ -61,13 +64,48 @@ Files: \n\
 
 enum
 {
-  DISK_BLOCK_NUM  = 16, // 8KB is the smallest size that windows allow to mount
+  DISK_BLOCK_NUM  = 32, // 8KB is the smallest size that windows allow to mount
   DISK_BLOCK_SIZE = 512
 };
 
+// Data region starts at LBA 3 with cluster 2, one sector per cluster
+#define LBA_TO_CLUSTER(lba) ((lba) - 1)
+
+#define PROFILES_BIN_LBA    15
+#define PROFILES_BIN_BLOCKS 8
+
+_Static_assert(PROFILES_BIN_SIZE <= PROFILES_BIN_BLOCKS * DISK_BLOCK_SIZE, "PROFILES.BIN does not fit its blocks");
+_Static_assert(PROFILES_BIN_LBA + PROFILES_BIN_BLOCKS <= DISK_BLOCK_NUM, "PROFILES.BIN does not fit the disk");
+_Static_assert(sizeof(README_CONTENTS) <= DISK_BLOCK_SIZE, "README.TXT does not fit one block");
+
 
 uint8_t local_buffer[DISK_BLOCK_SIZE] = {};
 
+// Writes are queued by tud_msc_write10_cb() and applied by msc_task().
+// Room for every sector that is kept (directory, profile files, selection and
+// PROFILES.BIN) - the disk is small enough that no single write queues more.
+#define MSC_WRITE_QUEUE_SIZE (1 + 9 + 1 + PROFILES_BIN_BLOCKS)
+
+typedef struct {
+    uint32_t lba;
+    uint32_t offset;
+    uint32_t size;
+    uint8_t  data[DISK_BLOCK_SIZE];
+} msc_write_t;
+
+static msc_write_t write_queue[MSC_WRITE_QUEUE_SIZE];
+static uint32_t write_queue_head = 0;
+static uint32_t write_queue_tail = 0;
+
+uint32_t msc_task_max_us = 0;
+static uint32_t msc_burst_writes = 0;      // sectors since the queue was last empty
+
+extern uint32_t hid_report_latency_max_us;
+
+// PROFILES.BIN upload is assembled here and only copied over profiles once complete and valid
+static uint8_t profiles_bin_staging[PROFILES_BIN_BLOCKS * DISK_BLOCK_SIZE];
+static uint32_t profiles_bin_received = 0; // bit per received block
+
 //------------- Block0: Boot Sector -------------//
 // byte_per_sector    = DISK_BLOCK_SIZE; fat12_sector_num_16  = DISK_BLOCK_NUM;
 // sector_per_cluster = 1; reserved_sectors = 1;
@@ -78,16 +116,17 @@ uint8_t local_buffer[DISK_BLOCK_SIZE] = {};
 // FAT magic code at offset 510-511
 const uint8_t boot_sector_block_data[] = {
     0xEB, 0x3C, 0x90, 0x4D, 0x53, 0x44, 0x4F, 0x53, 0x35, 0x2E, 0x30, 0x00, 0x02, 0x01, 0x01, 0x00,
-    0x01, 0x10, 0x00, 0x10, 0x00, 0xF8, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x10, 0x00, DISK_BLOCK_NUM & 0xFF, DISK_BLOCK_NUM >> 8, 0xF8, 0x01, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x29, 0x34, 0x12, 0x00, 0x00, 'E' , 'W' , 'h' , 'e' , 'e' ,
     'l' , ' ' , ' ' , ' ' , ' ' , ' ' , 0x46, 0x41, 0x54, 0x31, 0x32, 0x20, 0x20, 0x20, 0x00, 0x00,
 };
 
 const uint8_t boot_second_footer_data[] = { 0x55, 0xAA };
 
+// Clusters 0-13: single cluster files (end of chain); PROFILES.BIN chain is added in read
 const uint8_t fat_block_data[] = {
     0xF8, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
 
     // 0xF8, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00,
     // 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -110,6 +149,12 @@ const uint8_t root_dir_entry_template[] = {
     0x41, 0x55, 0x41, 0x55, 0x00, 0x00, 0x27, 0x6E, 0x41, 0x55, 0x03, 0x00, 0x04, 0x00, 0x00, 0x00,
 };
 
+const uint8_t root_dir_profiles_bin_file_data[] = {
+    'P' , 'R' , 'O' , 'F' , 'I' , 'L' , 'E' , 'S' , 'B' , 'I' , 'N' , 0x20, 0x00, 0xC6, 0x52, 0x6D,
+    0x65, 0x43, 0x65, 0x43, 0x00, 0x00, 0x88, 0x6D, 0x65, 0x43, LBA_TO_CLUSTER(PROFILES_BIN_LBA), 0x00,
+    PROFILES_BIN_SIZE & 0xFF, (PROFILES_BIN_SIZE >> 8) & 0xFF, 0x00, 0x00, // file size (4 Bytes)
+};
+
 const uint8_t root_dir_profile_file_data[] = {
     'P' , 'R' , 'O' , 'F' , 'I' , 'L' , 'E' , ' ' , 'T' , 'X' , 'T' , 0x20, 0x00, 0xC6, 0x52, 0x6D,
     0x65, 0x43, 0x65, 0x43, 0x00, 0x00, 0x88, 0x6D, 0x65, 0x43, 0x0D, 0x00, 1, 0x00, 0x00, 0x00, // readme's files size (4 Bytes)
@@ -121,46 +166,132 @@ const uint8_t readme_block_data[] = README_CONTENTS;
 
 #define PROFILE_JSON_TEMPLATE "{\n\
   \"direction\": % 1i,\n\
-  \"zero\": %03i,\n\
   \"dividers\": %02i,\n\
   \"expo\": % 02.3f,\n\
   \"gain\": %02.3f,\n\
   \"dead_band\": %02.3f,\n\
   \"fullres\": % 1i,\n\
+  \"debounce\": %03i,\n\
+  \"long_press\": %04i,\n\
+  \"accel_gain\": %i,\n\
+  \"accel_low\": %i,\n\
+  \"accel_high\": %i,\n\
+  \"accel_curve\": %i,\n\
   \"wheel_main\": %08X,\n\
   \"wheel_alt\": %08X,\n\
-  \"k1_main\": %08X,\n\
-  \"k1_alt\": %08X,\n\
-  \"k2_main\": %08X,\n\
-  \"k2_alt\": %08X,\n\
-  \"k3_main\": %08X,\n\
-  \"k3_alt\": %08X,\n\
-}\n"
+  \"keys\": ["
+
+#define PROFILE_JSON_KEYS_PER_LINE 4
 
 
 uint32_t key_to_uint32_t(key_action_t k) {
-    return k.type << 24 | k.sub_type << 16 | k.value;
+    return k.type << 24 | k.sub_type << 16 | (uint16_t)k.value;
 }
 
+// With buffer NULL only returns the length
 ssize_t output_profile(uint8_t* buffer, int profile_no) {
-    return sprintf(
-        buffer, PROFILE_JSON_TEMPLATE,
+    size_t size = buffer ? DISK_BLOCK_SIZE : 0;
+    size_t len = snprintf(
+        buffer, size, PROFILE_JSON_TEMPLATE,
         profiles[profile_no].direction,
-        profiles[profile_no].zero,
         profiles[profile_no].dividers,
         profiles[profile_no].expo,
         profiles[profile_no].gain_factor,
         profiles[profile_no].dead_band,
         profiles[profile_no].full_resolution,
+        profiles[profile_no].key_debounce_time,
+        profiles[profile_no].key_long_press_time,
+        profiles[profile_no].accel_gain,
+        profiles[profile_no].accel_low,
+        profiles[profile_no].accel_high,
+        profiles[profile_no].accel_curve,
         key_to_uint32_t(profiles[profile_no].wheel_main),
-        key_to_uint32_t(profiles[profile_no].wheel_alt),
-        key_to_uint32_t(profiles[profile_no].key1),
-        key_to_uint32_t(profiles[profile_no].key2),
-        key_to_uint32_t(profiles[profile_no].key3)
+        key_to_uint32_t(profiles[profile_no].wheel_alt)
     );
+    for (int i = 0; i < PROFILE_KEY_COUNT; i++) {
+        len += snprintf(
+            buffer ? buffer + len : NULL, size > len ? size - len : 0,
+            i == 0 ? "%08X" : (i % PROFILE_JSON_KEYS_PER_LINE == 0 ? ",\n    %08X" : ", %08X"),
+            key_to_uint32_t(profiles[profile_no].keys[i]));
+    }
+    len += snprintf(buffer ? buffer + len : NULL, size > len ? size - len : 0, "]\n}\n");
+    return len;
 }
 
 
+void fat12_set_entry(uint8_t* fat, uint32_t cluster, uint16_t value) {
+    uint32_t ptr = cluster * 3 / 2;
+    if (cluster & 1) {
+        fat[ptr] = (fat[ptr] & 0x0F) | ((value & 0x0F) << 4);
+        fat[ptr + 1] = (value >> 4) & 0xFF;
+    } else {
+        fat[ptr] = value & 0xFF;
+        fat[ptr + 1] = (fat[ptr + 1] & 0xF0) | ((value >> 8) & 0x0F);
+    }
+}
+
+void profiles_bin_read(uint8_t* buffer, uint32_t offset, uint32_t bufsize) {
+    profiles_bin_header_t header = {
+        .magic = PROFILES_BIN_MAGIC,
+        .version = PROFILES_BIN_VERSION,
+        .header_size = sizeof(profiles_bin_header_t),
+        .profile_size = sizeof(profile_t),
+        .profile_count = PROFILE_COUNT,
+        .crc32 = 0
+    };
+    if (offset < sizeof(header)) {
+        header.crc32 = crc32((const uint8_t*)profiles, PROFILE_COUNT * sizeof(profile_t));
+    }
+
+    memset(buffer, 0, bufsize);
+    for (uint32_t i = 0; i < bufsize && offset + i < PROFILES_BIN_SIZE; i++) {
+        uint32_t pos = offset + i;
+        if (pos < sizeof(header)) {
+            buffer[i] = ((const uint8_t*)&header)[pos];
+        } else {
+            buffer[i] = ((const uint8_t*)profiles)[pos - sizeof(header)];
+        }
+    }
+}
+
+// Replaces all profiles at once when every block of a valid image has been received,
+// tried on every block and done once the last one the header asks for is in
+void profiles_bin_commit() {
+    if (!(profiles_bin_received & 1)) { return; }
+
+    profiles_bin_header_t header;
+    memcpy(&header, profiles_bin_staging, sizeof(header));
+
+    uint32_t size = header.header_size + header.profile_count * header.profile_size;
+    if (header.magic != PROFILES_BIN_MAGIC || size > sizeof(profiles_bin_staging)) {
+        LOG(LOG_PROFILES_BIN_BAD_HEADER);
+        profiles_bin_received = 0;
+        return;
+    }
+
+    uint32_t needed = (1 << ((size + DISK_BLOCK_SIZE - 1) / DISK_BLOCK_SIZE)) - 1;
+    if ((profiles_bin_received & needed) != needed) { return; }
+    profiles_bin_received = 0;
+
+    if (header.version != PROFILES_BIN_VERSION
+            || header.header_size != sizeof(profiles_bin_header_t)
+            || header.profile_size != sizeof(profile_t)
+            || header.profile_count != PROFILE_COUNT) {
+        LOG(LOG_PROFILES_BIN_BAD_VERSION, header.version);
+        return;
+    }
+
+    uint8_t* profiles_data = profiles_bin_staging + header.header_size;
+    if (crc32(profiles_data, PROFILE_COUNT * sizeof(profile_t)) != header.crc32) {
+        LOG(LOG_PROFILES_BIN_BAD_CRC);
+        return;
+    }
+
+    memcpy(profiles, profiles_data, PROFILE_COUNT * sizeof(profile_t));
+    set_profile(selected_profile);
+    LOG(LOG_PROFILES_BIN_RECEIVED, PROFILE_COUNT);
+}
+
 // --------------------------------------------------------------------
 
 // Invoked when received SCSI_CMD_INQUIRY
@@ -236,7 +367,13 @@ int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buff
       }
       break;
       case (1): {
+          memset(buffer, 0, bufsize);
           memcpy(buffer, fat_block_data, sizeof(fat_block_data));
+          uint32_t first_cluster = LBA_TO_CLUSTER(PROFILES_BIN_LBA);
+          uint32_t clusters = (PROFILES_BIN_SIZE + DISK_BLOCK_SIZE - 1) / DISK_BLOCK_SIZE;
+          for (uint32_t i = 0; i < clusters; i++) {
+              fat12_set_entry(buffer, first_cluster + i, (i + 1 < clusters) ? first_cluster + i + 1 : 0xFFF);
+          }
       }
       break;
       case (2): {
@@ -259,7 +396,8 @@ int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buff
               local_buffer[64 + 32 * i + 30] = 0;
               local_buffer[64 + 32 * i + 31] = 0;
           }
-          memcpy(local_buffer + 32 * 11, root_dir_profile_file_data, sizeof(root_dir_profile_file_data));
+          memcpy(local_buffer + 32 * 12, root_dir_profile_file_data, sizeof(root_dir_profile_file_data));
+          memcpy(local_buffer + 32 * 13, root_dir_profiles_bin_file_data, sizeof(root_dir_profiles_bin_file_data));
           memcpy(buffer, local_buffer, bufsize);
       }
       break;
@@ -283,14 +421,14 @@ int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void* buff
           memcpy(buffer, local_buffer, bufsize);
       }
       break;
-      case (15): {
-
+      case PROFILES_BIN_LBA ... PROFILES_BIN_LBA + PROFILES_BIN_BLOCKS - 1: {
+          profiles_bin_read(buffer, (lba - PROFILES_BIN_LBA) * DISK_BLOCK_SIZE + offset, bufsize);
       }
       break;
       default: break;
     }
 #ifdef DEBUG_MSC
-    printf("Received read lba=%i, offset=%i\n", lba, offset);
+    LOG(LOG_MSC_READ, lba, offset);
 #endif
     return (int32_t) bufsize;
 }
@@ -303,22 +441,85 @@ bool tud_msc_is_writable_cb (uint8_t lun) {
     return true;
 }
 
+void process_write(msc_write_t* write);
+
+static void msc_apply_queued_write() {
+    uint32_t started_us = time_us_32();
+
+    process_write(&write_queue[write_queue_tail % MSC_WRITE_QUEUE_SIZE]);
+    write_queue_tail += 1;
+
+    uint32_t took_us = time_us_32() - started_us;
+    if (took_us > msc_task_max_us) {
+        msc_task_max_us = took_us;
+#ifdef DEBUG_MSC
+        LOG(LOG_MSC_TASK_MAX_TIME, msc_task_max_us);
+#endif
+    }
+}
+
 // Callback invoked when received WRITE10 command.
-// Process data in buffer to disk's storage and return number of written bytes
+// Only copies the sector into the write queue - it is applied later by msc_task()
+// so tud_task() (and with it HID reports) is not held up by parsing profiles.
+// Returning 0 would have TinyUSB retry the same data within the same tud_task()
+// call, so a write that still finds the queue full (several commands before
+// msc_task() got to run) fails as not ready and the host retries it.
 int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize) {
     (void) lun;
 
     // out of ramdisk
     if (lba >= DISK_BLOCK_NUM) { return -1; }
 
+#ifdef DEBUG_MSC
+    LOG(LOG_MSC_WRITE, lba, offset);
+#endif
+
     switch (lba) {
+      case (2):
+      case 5 ... 13:
+      case (14):
+      case PROFILES_BIN_LBA ... PROFILES_BIN_LBA + PROFILES_BIN_BLOCKS - 1: {
+          if (offset >= DISK_BLOCK_SIZE) { return (int32_t) bufsize; }
+          if (write_queue_head == write_queue_tail && msc_burst_writes == 0) {
+              hid_report_latency_max_us = 0;
+              msc_task_max_us = 0;
+          }
+          if (write_queue_head - write_queue_tail >= MSC_WRITE_QUEUE_SIZE) {
+              // Additional Sense 04-01 is BECOMING_READY
+              tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x04, 0x01);
+              return -1;
+          }
+          if (bufsize > DISK_BLOCK_SIZE - offset) { bufsize = DISK_BLOCK_SIZE - offset; }
+
+          msc_write_t* write = &write_queue[write_queue_head % MSC_WRITE_QUEUE_SIZE];
+          write->lba = lba;
+          write->offset = offset;
+          write->size = bufsize;
+          memcpy(write->data, buffer, bufsize);
+          write_queue_head += 1;
+          msc_burst_writes += 1;
+      }
       break;
+      default: break;
+    }
+
+    // TODO not readonly and not writable
+    // uint8_t* addr = msc_disk[lba] + offset;
+    // memcpy(addr, buffer, bufsize);
+
+    return (int32_t) bufsize;
+}
+
+void process_write(msc_write_t* write) {
+    uint8_t* buffer = write->data;
+
+    switch (write->lba) {
       case (2): {
         if (received_profile_number >= 0 && received_profile_number <= 8) {
           uint8_t ptr = 64 + 32 + received_profile_number * 32 + 28;
 
           ssize_t profile_json_size = buffer[ptr] + 256 * buffer[ptr + 1];
-          printf("Received profile %i with size %i\n", received_profile_number + 1, profile_json_size);
+          LOG(LOG_MSC_PROFILE_RECEIVED, received_profile_number + 1, profile_json_size);
 
           if (profile_json_size > 511) { profile_json_size = 511; }
           local_buffer[profile_json_size] = 0x0; // Make it null terminated
@@ -330,18 +531,43 @@ int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t*
           const nx_json* json = nx_json_parse(local_buffer, 0);
           if (json) {
               profiles[received_profile_number].direction = nx_json_get(json, "direction")->num.s_value;
-              profiles[received_profile_number].zero = nx_json_get(json, "zero")->num.s_value;
               profiles[received_profile_number].dividers = nx_json_get(json, "dividers")->num.s_value;
               profiles[received_profile_number].expo = nx_json_get(json, "expo")->num.dbl_value;
               profiles[received_profile_number].gain_factor = nx_json_get(json, "gain")->num.dbl_value;
               profiles[received_profile_number].dead_band = nx_json_get(json, "dead_band")->num.dbl_value;
 
-              printf("direction=%d\n", profiles[received_profile_number].direction);
-              printf("zero=%d\n",      profiles[received_profile_number].zero);
-              printf("dividers=%d\n",  profiles[received_profile_number].dividers);
-              printf("expo=%f\n",      profiles[received_profile_number].expo);
-              printf("gain=%f\n",      profiles[received_profile_number].gain_factor);
-              printf("dead_band=%f\n", profiles[received_profile_number].dead_band);
+              const nx_json* debounce = nx_json_get(json, "debounce");
+              if (debounce->type == NX_JSON_INTEGER) {
+                  profiles[received_profile_number].key_debounce_time = debounce->num.s_value;
+              }
+              const nx_json* long_press = nx_json_get(json, "long_press");
+              if (long_press->type == NX_JSON_INTEGER) {
+                  profiles[received_profile_number].key_long_press_time = long_press->num.s_value;
+              }
+              const nx_json* accel_gain = nx_json_get(json, "accel_gain");
+              if (accel_gain->type == NX_JSON_INTEGER) {
+                  profiles[received_profile_number].accel_gain = accel_gain->num.s_value;
+              }
+              const nx_json* accel_low = nx_json_get(json, "accel_low");
+              if (accel_low->type == NX_JSON_INTEGER) {
+                  profiles[received_profile_number].accel_low = accel_low->num.s_value;
+              }
+              const nx_json* accel_high = nx_json_get(json, "accel_high");
+              if (accel_high->type == NX_JSON_INTEGER) {
+                  profiles[received_profile_number].accel_high = accel_high->num.s_value;
+              }
+              const nx_json* accel_curve = nx_json_get(json, "accel_curve");
+              if (accel_curve->type == NX_JSON_INTEGER) {
+                  profiles[received_profile_number].accel_curve = accel_curve->num.s_value;
+              }
+
+              LOG(LOG_MSC_PROFILE_INT_VALUES,
+                  profiles[received_profile_number].direction,
+                  profiles[received_profile_number].dividers);
+              LOG(LOG_MSC_PROFILE_FLOAT_VALUES,
+                  log_f(profiles[received_profile_number].expo),
+                  log_f(profiles[received_profile_number].gain_factor),
+                  log_f(profiles[received_profile_number].dead_band));
               nx_json_free(json);
 
             //   set_profile(received_profile_number);
@@ -352,8 +578,8 @@ int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t*
       }
       break;
       case 5 ... 13: {
-          received_profile_number = lba - 5;
-          memcpy(local_buffer, buffer, bufsize);
+          received_profile_number = write->lba - 5;
+          memcpy(local_buffer + write->offset, buffer, write->size);
       }
       break;
       case 14: {
@@ -361,27 +587,43 @@ int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t*
               reset_usb_boot(0, 0);
           } else {
                 uint32_t selection = buffer[0] - '1';
-                if (selection >= 0 && selection < 9) {
+                if (selection >= 0 && selection < PROFILE_COUNT) {
                     set_profile(selection);
-                    printf("Selected profile %d", selection);
+                    LOG(LOG_MSC_PROFILE_SELECTED, selection);
 
                 }
           }
       }
       break;
+      case PROFILES_BIN_LBA ... PROFILES_BIN_LBA + PROFILES_BIN_BLOCKS - 1: {
+          uint32_t block = write->lba - PROFILES_BIN_LBA;
+          memcpy(profiles_bin_staging + block * DISK_BLOCK_SIZE + write->offset, buffer, write->size);
+          // The header starts an upload - blocks left over from one that stopped
+          // partway must not complete it
+          if (block == 0) {
+              profiles_bin_received = 1;
+          } else {
+              profiles_bin_received |= 1 << block;
+          }
+          profiles_bin_commit();
+      }
+      break;
       default: break;
     }
+}
 
+// Applies at most one queued write per call. Called from the main loop
+// after HID reports are sent so applying profiles never delays them.
+// Once a burst of writes is applied, logs the HID report latency seen meanwhile.
+void msc_task() {
+    if (write_queue_tail == write_queue_head) { return; }
 
-    // TODO not readonly and not writable
-    // uint8_t* addr = msc_disk[lba] + offset;
-    // memcpy(addr, buffer, bufsize);
+    msc_apply_queued_write();
 
-    (void) lba; (void) offset; (void) buffer;
-#ifdef DEBUG_MSC
-    printf("Received write lba=%i, offset=%i\n", lba, offset);
-#endif
-    return (int32_t) bufsize;
+    if (write_queue_tail == write_queue_head) {
+        LOG(LOG_MSC_WRITES_APPLIED, msc_burst_writes, msc_task_max_us, hid_report_latency_max_us);
+        msc_burst_writes = 0;
+    }
 }
 
 // Callback invoked when received an SCSI command not in built-in list below
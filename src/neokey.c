@@ -1,104 +1,80 @@
-
 #include <string.h>
 #include "pico/stdlib.h"
 #include "bsp/board.h"
-#include "hardware/i2c.h"
 #include "neokey.h"
+#include "i2c_bus.h"
+#include "scheduler.h"
+#include "log.h"
+
+extern int i2c_bus_write(uint8_t device, uint8_t address, const uint8_t* src, size_t len, bool nostop);
+extern int i2c_bus_read(uint8_t device, uint8_t address, uint8_t* dst, size_t len, bool nostop);
+extern void scheduler_wake(uint8_t source);
 
 #define DEBUG_INIT 0
 #define DEBUG_READ_KEYS 0
 #define DEBUG_WRITE_LEDS 0
-#define DEBUG_PROCESS_KEYS 0
 
+// Read key edges from the Seesaw keypad event FIFO instead of polling GPIO_BULK.
+// Falls back to GPIO polling if the board doesn't accept keypad events.
+#define NEOKEY_USE_KEYPAD_FIFO 1
+
+typedef struct {
+    uint8_t address;
+    bool initialised;
+    bool keypad_fifo;
+    uint8_t step;                           // next initialisation step
+    uint8_t chip_id;
+    uint32_t failures;                      // consecutive failed attempts
+    uint32_t retry_at;
+    uint32_t backoff;
+    bool leds_valid;                        // leds_written matches the board
+    bool leds_show;                         // written, waiting for show_leds()
+    uint8_t leds_written[NEOKEY_LED_BUF_SIZE];
+} neokey_board_t;
+
+static const uint8_t board_addresses[NEOKEY_MAX_BOARDS] = NEOKEY_I2C_ADDRESSES;
+static neokey_board_t boards[NEOKEY_MAX_BOARDS];
+
+// First board only, for debugging
 uint8_t buttons[4] = {0, 0, 0, 0};
 volatile uint8_t buttons_state = 0;
-volatile uint8_t leds[12] = {0x20, 0, 0x20, 0x20, 0, 0, 0x20, 0x20, 0, 0, 0x20, 0};
+
+volatile uint8_t leds[NEOKEY_LEDS_SIZE] = {0x20, 0, 0x20, 0x20, 0, 0, 0x20, 0x20, 0, 0, 0x20, 0};
 // volatile uint8_t leds[12] = {0, 0x20, 0, 0x20, 0x20, 0, 0x20, 0, 0, 0x20, 0, 0x20};
 
 static uint8_t buf[20];
 
-static uint32_t initialised = false;
-
-static neokey_key_t keys[4] = {
-  {  .bt_mask = (1 << BUTTON_A), .bt_prev_state = (1 << BUTTON_A), .st_current_state = ST_RELEASED, .has_change = 0, .key_state = KEY_RELEASED },
-  {  .bt_mask = (1 << BUTTON_B), .bt_prev_state = (1 << BUTTON_B), .st_current_state = ST_RELEASED, .has_change = 0, .key_state = KEY_RELEASED },
-  {  .bt_mask = (1 << BUTTON_C), .bt_prev_state = (1 << BUTTON_C), .st_current_state = ST_RELEASED, .has_change = 0, .key_state = KEY_RELEASED },
-  {  .bt_mask = (1 << BUTTON_D), .bt_prev_state = (1 << BUTTON_D), .st_current_state = ST_RELEASED, .has_change = 0, .key_state = KEY_RELEASED }
+// Bit per key, across all boards
+static uint16_t keys_pressed = 0;
+
+void keys_sample(uint16_t pressed, uint32_t now);
+void keys_configure(uint32_t debounce_time, uint32_t long_press);
+static void keys_set_hardware_debounce(bool hardware_debounce);
+
+// Board initialisation is split in steps of one or two short transfers. At boot
+// they run back to back; a board that fails later (or wasn't there at boot) is
+// brought back by neokey_recovery_task() one step per call, with exponential backoff
+// between attempts so a missing board costs next to nothing.
+enum {
+    NEOKEY_STEP_RESET = 0,
+    NEOKEY_STEP_HW_ID,
+    NEOKEY_STEP_VERSION,
+    NEOKEY_STEP_PIN,
+    NEOKEY_STEP_BUF_LEN,
+    NEOKEY_STEP_DIRCLR,
+    NEOKEY_STEP_PULLENSET,
+    NEOKEY_STEP_BULKSET,
+    NEOKEY_STEP_INTENSET,
+    NEOKEY_STEP_KEYPAD,         // one step per key and edge
+    NEOKEY_STEP_DONE = NEOKEY_STEP_KEYPAD + 8,
 };
 
-static neokey_key_t akey = { .time = 0, .bt_mask = (1 << BUTTON_A), .bt_prev_state = (1 << BUTTON_A), .st_current_state = ST_RELEASED, .has_change = 0, .key_state = KEY_RELEASED };
-
-void neokey_init() {
-    int ret;
-
-    buf[0] = STATUS_BASE;
-    buf[1] = STATUS_HW_ID;
-    #if (DEBUG_INIT)
-        printf("write: [%i, %i]\n", buf[0], buf[1]);
-    #endif
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 2, false);
-    if (ret != 2) {
-        printf("ERROR: neokey_init(hd id) %i\n", ret);
-        return;
-    }
-    uint8_t rec[4];
-    ret = i2c_read_blocking(i2c_default, NEOKEY_I2C_ADDRESS, rec, 1, false);
-    if (ret != 1) {
-        printf("ERROR: neokey_init(hd id read) %i\n", ret);
-        return;
-    }
-    printf("Neokey chip_id %i", rec[0]);
-
-    buf[0] = STATUS_BASE;
-    buf[1] = STATUS_VERSION;
-    #if (DEBUG_INIT)
-        printf("\nwrite: [%i, %i]\n", buf[0], buf[1]);
-    #endif
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 2, false);
-    if (ret != 2) {
-        printf("\nERROR: neokey_init(ver) %i\n", ret);
-        return;
-    }
-    ret = i2c_read_blocking(i2c_default, NEOKEY_I2C_ADDRESS, rec, 4, false);
-    if (ret != 4) {
-        printf("\nERROR: neokey_init(ver read) %i\n", ret);
-        return;
-    }
-    #if (DEBUG_INIT)
-        printf("Neokey ");
-    #else
-        printf(", ");
-    #endif
-    printf("version %i, (%i, %i)\n", rec[0] << 8 | rec[1], rec[2], rec[3]);
-
-
-    buf[0] = NEOPIXEL_BASE;
-    buf[1] = NEOPIXEL_PIN;
-    buf[2] = 3;
-    #if (DEBUG_INIT)
-        printf("write: [%i, %i, %i]\n", buf[0], buf[1], buf[2]);
-    #endif
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 3, false);
-    if (ret != 3) {
-        printf("ERROR: neokey_init(neopixel pin) %i\n", ret);
-        return;
-    }
-
-    buf[0] = NEOPIXEL_BASE;
-    buf[1] = NEOPIXEL_BUF_LENGTH;
-    buf[2] = 0;
-    buf[3] = 12;
-    #if (DEBUG_INIT)
-        printf("write: [%i, %i, %i, %i]\n", buf[0], buf[1], buf[2], buf[3]);
-    #endif
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 4, false);
-    if (ret != 4) {
-        printf("ERROR: neokey_init(neopixel buf len) %i\n", ret);
-        return;
-    }
+// Errors are only logged at boot - a board that is down keeps failing every attempt
+#define NEOKEY_STEP_LOG(board, ...) do { if ((board)->failures == 0) { LOG(__VA_ARGS__); } } while (0)
 
+static int neokey_write_gpio_mask(neokey_board_t* board, uint8_t reg) {
     buf[0] = GPIO_BASE;
-    buf[1] = GPIO_DIRCLR_BULK;
+    buf[1] = reg;
     buf[2] = 0;
     buf[3] = 0;
     buf[4] = 0;
@@ -106,230 +82,552 @@ void neokey_init() {
     #if (DEBUG_INIT)
         printf("neokey_init write: [%i, %i, %i, %i, %i, %i]\n", buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]);
     #endif
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 6, false);
-    if (ret != 6) {
-        printf("ERROR: neokey_init(gpio dirclr) %i\n", ret);
-        return;
+    return i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 6, false);
+}
+
+// Returns false on error
+static bool neokey_init_step(neokey_board_t* board) {
+    int ret;
+    uint8_t rec[4];
+
+    switch (board->step) {
+        case (NEOKEY_STEP_RESET): {
+            // Best effort - the board may well not be there
+            buf[0] = STATUS_BASE;
+            buf[1] = STATUS_SWRST;
+            buf[2] = 0xFF;
+            i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 3, false);
+        }
+        break;
+        case (NEOKEY_STEP_HW_ID): {
+            buf[0] = STATUS_BASE;
+            buf[1] = STATUS_HW_ID;
+            #if (DEBUG_INIT)
+                printf("write 0x%02x: [%i, %i]\n", board->address, buf[0], buf[1]);
+            #endif
+            ret = i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 2, false);
+            if (ret != 2) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_HW_ID_ERROR, board->address, ret);
+                return false;
+            }
+            ret = i2c_bus_read(I2C_DEVICE_NEOKEY, board->address, rec, 1, false);
+            if (ret != 1) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_HW_ID_READ_ERROR, board->address, ret);
+                return false;
+            }
+            board->chip_id = rec[0];
+        }
+        break;
+        case (NEOKEY_STEP_VERSION): {
+            buf[0] = STATUS_BASE;
+            buf[1] = STATUS_VERSION;
+            #if (DEBUG_INIT)
+                printf("\nwrite: [%i, %i]\n", buf[0], buf[1]);
+            #endif
+            ret = i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 2, false);
+            if (ret != 2) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_VERSION_ERROR, board->address, ret);
+                return false;
+            }
+            ret = i2c_bus_read(I2C_DEVICE_NEOKEY, board->address, rec, 4, false);
+            if (ret != 4) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_VERSION_READ_ERROR, board->address, ret);
+                return false;
+            }
+            NEOKEY_STEP_LOG(board, LOG_NEOKEY_VERSION, board->chip_id, rec[0] << 8 | rec[1], rec[2], rec[3]);
+        }
+        break;
+        case (NEOKEY_STEP_PIN): {
+            buf[0] = NEOPIXEL_BASE;
+            buf[1] = NEOPIXEL_PIN;
+            buf[2] = 3;
+            #if (DEBUG_INIT)
+                printf("write: [%i, %i, %i]\n", buf[0], buf[1], buf[2]);
+            #endif
+            ret = i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 3, false);
+            if (ret != 3) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_PIN_ERROR, board->address, ret);
+                return false;
+            }
+        }
+        break;
+        case (NEOKEY_STEP_BUF_LEN): {
+            buf[0] = NEOPIXEL_BASE;
+            buf[1] = NEOPIXEL_BUF_LENGTH;
+            buf[2] = 0;
+            buf[3] = NEOKEY_LED_BUF_SIZE;
+            #if (DEBUG_INIT)
+                printf("write: [%i, %i, %i, %i]\n", buf[0], buf[1], buf[2], buf[3]);
+            #endif
+            ret = i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 4, false);
+            if (ret != 4) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_BUF_LEN_ERROR, board->address, ret);
+                return false;
+            }
+        }
+        break;
+        case (NEOKEY_STEP_DIRCLR): {
+            ret = neokey_write_gpio_mask(board, GPIO_DIRCLR_BULK);
+            if (ret != 6) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_DIRCLR_ERROR, board->address, ret);
+                return false;
+            }
+        }
+        break;
+        case (NEOKEY_STEP_PULLENSET): {
+            ret = neokey_write_gpio_mask(board, GPIO_PULLENSET);
+            if (ret != 6) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_PULLENSET_ERROR, board->address, ret);
+                return false;
+            }
+        }
+        break;
+        case (NEOKEY_STEP_BULKSET): {
+            ret = neokey_write_gpio_mask(board, GPIO_BULK_SET);
+            if (ret != 6) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_BULKSET_ERROR, board->address, ret);
+                return false;
+            }
+        }
+        break;
+        case (NEOKEY_STEP_INTENSET): {
+            ret = neokey_write_gpio_mask(board, GPIO_INTENSET);
+            if (ret != 6) {
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_INTENSET_ERROR, board->address, ret);
+                return false;
+            }
+            board->keypad_fifo = NEOKEY_USE_KEYPAD_FIFO;
+        }
+        break;
+        case NEOKEY_STEP_KEYPAD ... NEOKEY_STEP_DONE - 1: {
+            if (!board->keypad_fifo) { break; }
+
+            uint8_t n = board->step - NEOKEY_STEP_KEYPAD;
+            buf[0] = KEYPAD_BASE;
+            buf[1] = KEYPAD_EVENT;
+            buf[2] = BUTTON_A + n / 2;
+            buf[3] = KEYPAD_EVENT_ENABLE(KEYPAD_EDGE_FALLING + n % 2);
+            #if (DEBUG_INIT)
+                printf("neokey_init write: [%i, %i, %i, %i]\n", buf[0], buf[1], buf[2], buf[3]);
+            #endif
+            ret = i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 4, false);
+            if (ret != 4) {
+                // Not an error - the board just doesn't do keypad events
+                NEOKEY_STEP_LOG(board, LOG_NEOKEY_KEYPAD_ERROR, board->address, ret);
+                board->keypad_fifo = false;
+            }
+        }
+        break;
+        default: break;
     }
+    board->step += 1;
+    return true;
+}
 
-    buf[1] = GPIO_PULLENSET;
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 6, false);
-    #if (DEBUG_INIT)
-        printf("neokey_init write: [%i, %i, %i, %i, %i, %i]\n", buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]);
-    #endif
-    if (ret != 6) {
-        printf("ERROR: neokey_init(gpio pullenset) %i\n", ret);
-        return;
+static void neokey_update_debounce() {
+    bool hardware_debounce = true;
+    int initialised_boards = 0;
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        if (boards[b].initialised) {
+            initialised_boards += 1;
+            hardware_debounce = hardware_debounce && boards[b].keypad_fifo;
+        }
     }
+    keys_set_hardware_debounce(initialised_boards > 0 && hardware_debounce);
+}
 
-    buf[1] = GPIO_BULK_SET;
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 6, false);
-    #if (DEBUG_INIT)
-        printf("neokey_init write: [%i, %i, %i, %i, %i, %i]\n", buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]);
-    #endif
-    if (ret != 6) {
-        printf("ERROR: neokey_init(gpio bulkset) %i\n", ret);
-        return;
+static void neokey_board_ready(neokey_board_t* board) {
+    board->leds_valid = false;
+    board->leds_show = false;
+    board->initialised = true;
+    if (board->failures > 0) {
+        LOG(LOG_NEOKEY_RECOVERED, board->address, board->failures);
+    } else {
+        LOG(LOG_NEOKEY_INITIALISED, board->address, board->keypad_fifo);
     }
+    board->failures = 0;
+    board->backoff = NEOKEY_RECOVERY_BACKOFF_MIN;
+    neokey_update_debounce();
+}
 
-    buf[1] = GPIO_INTENSET;
-    ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 6, false);
-    #if (DEBUG_INIT)
-        printf("neokey_init write: [%i, %i, %i, %i, %i, %i]\n", buf[0], buf[1], buf[2], buf[3], buf[4], buf[5]);
-    #endif
-    if (ret != 6) {
-        printf("ERROR: neokey_init(gpio intenset) %i\n", ret);
-        return;
+static void neokey_schedule_retry(neokey_board_t* board, uint32_t now) {
+    board->failures += 1;
+    board->step = NEOKEY_STEP_RESET;
+    board->retry_at = now + board->backoff;
+    board->backoff *= 2;
+    if (board->backoff > NEOKEY_RECOVERY_BACKOFF_MAX) { board->backoff = NEOKEY_RECOVERY_BACKOFF_MAX; }
+}
+
+void neokey_init() {
+    uint32_t now = board_millis();
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        neokey_board_t* board = &boards[b];
+        board->address = board_addresses[b];
+        board->initialised = false;
+        board->failures = 0;
+        board->backoff = NEOKEY_RECOVERY_BACKOFF_MIN;
+        if (board->address == 0) { continue; }
+
+        // No reset at boot, the board has just powered up with us
+        board->step = NEOKEY_STEP_HW_ID;
+        while (board->step < NEOKEY_STEP_DONE && neokey_init_step(board)) { }
+        if (board->step == NEOKEY_STEP_DONE) {
+            neokey_board_ready(board);
+        } else {
+            neokey_schedule_retry(board, now);
+        }
     }
+    keys_pressed = 0;
+    neokey_update_debounce();
+}
+
+static void neokey_board_failed(int b, uint8_t state) {
+    boards[b].initialised = false;
+    neokey_schedule_retry(&boards[b], board_millis());
+    if (b == 0) { buttons_state = state; }
+}
 
-    initialised = true;
-    printf("Neokey initialised\n");
+// Background job - one initialisation step of one board that is down
+void neokey_recovery_task() {
+    static int next_board = 0;
+    uint32_t now = board_millis();
+
+    for (int n = 0; n < NEOKEY_MAX_BOARDS; n++) {
+        int b = (next_board + n) % NEOKEY_MAX_BOARDS;
+        neokey_board_t* board = &boards[b];
+        if (board->address == 0 || board->initialised || (int32_t)(now - board->retry_at) < 0) { continue; }
+
+        next_board = b + 1;
+        uint8_t step = board->step;
+        if (!neokey_init_step(board)) {
+            neokey_schedule_retry(board, now);
+        } else if (board->step == NEOKEY_STEP_DONE) {
+            neokey_board_ready(board);
+        } else if (step == NEOKEY_STEP_RESET) {
+            board->retry_at = now + NEOKEY_RESET_TIME;
+        }
+        return;
+    }
 }
 
+// Writes LED buffers of boards whose LEDs changed since they were last written,
+// no more than NEOKEY_LED_WRITES_PER_CALL of them so bus time stays bounded
+// however many boards there are. The rest are picked up next time round.
 void write_leds() {
-    if (initialised) {
-        int ret;
+    static int next_board = 0;
+    int writes = 0;
+
+    for (int n = 0; n < NEOKEY_MAX_BOARDS && writes < NEOKEY_LED_WRITES_PER_CALL; n++) {
+        int b = (next_board + n) % NEOKEY_MAX_BOARDS;
+        neokey_board_t* board = &boards[b];
+        if (!board->initialised || board->leds_show) { continue; }
+
+        for (int i = 0; i < NEOKEY_LED_BUF_SIZE; i++) { buf[i + 4] = leds[b * NEOKEY_LED_BUF_SIZE + i]; }
+        if (board->leds_valid && memcmp(board->leds_written, buf + 4, NEOKEY_LED_BUF_SIZE) == 0) { continue; }
 
         buf[0] = NEOPIXEL_BASE;
         buf[1] = NEOPIXEL_BUF;
         buf[2] = 0;
         buf[3] = 0;
 
-        for (int i = 0; i < 12; i++) { buf[i + 4] = leds[i]; }
-
         #if (DEBUG_WRITE_LEDS)
-            printf("write_leds: [%i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i]\n",
+            printf("write_leds 0x%02x: [%i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i, %i]\n",
+                board->address,
                 buf[0], buf[1], buf[2], buf[3], buf[4], buf[5], buf[6], buf[7],
                 buf[8], buf[9], buf[10], buf[11], buf[12], buf[13], buf[14], buf[15]
             );
         #endif
-        ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 16, false);
-        if (ret != 16) {
-            printf("ERROR: write_leds %i\n", ret);
-            initialised = false;
-            return;
+        int ret = i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 4 + NEOKEY_LED_BUF_SIZE, false);
+        if (ret != 4 + NEOKEY_LED_BUF_SIZE) {
+            LOG(LOG_NEOKEY_WRITE_LEDS_ERROR, board->address, ret);
+            neokey_board_failed(b, buttons_state);
+            continue;
         }
+        memcpy(board->leds_written, buf + 4, NEOKEY_LED_BUF_SIZE);
+        board->leds_valid = true;
+        board->leds_show = true;
+        writes += 1;
+        next_board = b + 1;
     }
 }
 
 void show_leds() {
-    if (initialised) {
-        int ret;
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        neokey_board_t* board = &boards[b];
+        if (!board->initialised || !board->leds_show) { continue; }
 
         buf[0] = NEOPIXEL_BASE;
         buf[1] = NEOPIXEL_SHOW;
         #if (DEBUG_WRITE_LEDS)
-            printf("write_leds: [%i, %i]\n", buf[0], buf[1]);
+            printf("show_leds 0x%02x: [%i, %i]\n", board->address, buf[0], buf[1]);
         #endif
 
-        ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 2, false);
+        int ret = i2c_bus_write(I2C_DEVICE_NEOKEY, board->address, buf, 2, false);
         if (ret != 2) {
-            printf("ERROR: write_leds (show) %i\n", ret);
-            initialised = false;
-            return;
+            LOG(LOG_NEOKEY_SHOW_LEDS_ERROR, board->address, ret);
+            neokey_board_failed(b, buttons_state);
+            continue;
         }
+        board->leds_show = false;
     }
 }
 
-void read_keys_raw() {
-    if (initialised) {
-        int ret;
-
-        buf[0] = GPIO_BASE;
-        buf[1] = GPIO_BULK;
-        ret = i2c_write_blocking(i2c_default, NEOKEY_I2C_ADDRESS, buf, 2, false);
-        if (ret < 0) {
-            printf("ERROR: read_keys_raw write: %i\n", ret);
-            initialised = false;
-            buttons_state = 0xfe;
-            return;
+// Selects the same register on all boards in 'selected', waits once for the
+// Seesaws to prepare their replies and then reads 'len[b]' bytes back from each.
+// Boards that fail are dropped from the returned mask.
+static uint8_t read_boards(uint8_t selected, uint8_t reg_base, uint8_t reg,
+                           uint8_t data[NEOKEY_MAX_BOARDS][KEYPAD_FIFO_SIZE], const uint8_t len[NEOKEY_MAX_BOARDS]) {
+    buf[0] = reg_base;
+    buf[1] = reg;
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        if (!(selected & (1 << b))) { continue; }
+        int ret = i2c_bus_write(I2C_DEVICE_NEOKEY, boards[b].address, buf, 2, false);
+        if (ret != 2) {
+            LOG(LOG_NEOKEY_READ_KEYS_WRITE_ERROR, boards[b].address, ret);
+            neokey_board_failed(b, 0xfe);
+            selected &= ~(1 << b);
         }
-        #if (DEBUG_READ_KEYS)
-            printf("read_keys_raw: [%i, %i] -> ", buf[0], buf[1]);
-        #endif
+    }
+    if (!selected) { return 0; }
 
-        sleep_ms(2);
-        uint8_t rec[4];
-        ret = i2c_read_blocking(i2c_default, NEOKEY_I2C_ADDRESS, rec, 4, false);
-        if (ret != 4) {
-        #if (DEBUG_READ_KEYS)
-                printf("\n");
-            #endif
-            printf("ERROR: read_keys_raw read: %i\n", ret);
-            initialised = false;
-            buttons_state = 0xfd;
-            return;
+    sleep_us(NEOKEY_READ_DELAY_US);
+
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        if (!(selected & (1 << b))) { continue; }
+        int ret = i2c_bus_read(I2C_DEVICE_NEOKEY, boards[b].address, data[b], len[b], false);
+        if (ret != len[b]) {
+            LOG(LOG_NEOKEY_READ_KEYS_READ_ERROR, boards[b].address, ret);
+            neokey_board_failed(b, 0xfd);
+            selected &= ~(1 << b);
         }
-        #if (DEBUG_READ_KEYS)
-            printf("[%i, %i, %i, %i]\n", rec[0], rec[1], rec[2], rec[3]);
-        #endif
-        buttons_state = rec[3] & 0xf0;
-        for (int i = 0; i < 4; i++) { buttons[i] = rec[i]; }
-    } else {
-        buttons_state = 0xff;
     }
+    return selected;
 }
 
-void set_key_state(neokey_key_t* key, int key_state) {
-    if (key->key_state != key_state) {
-        key->key_state = key_state;
-        key->has_change = 1;
+// Polls keys of all boards. GPIO boards return their pin state, keypad FIFO boards
+// the number of queued events, which are then drained - again with one shared delay.
+void read_keys_raw() {
+    uint8_t data[NEOKEY_MAX_BOARDS][KEYPAD_FIFO_SIZE];
+    uint8_t len[NEOKEY_MAX_BOARDS];
+    uint8_t gpio_boards = 0;
+    uint8_t fifo_boards = 0;
+    uint32_t now = board_millis();
+
+    if (!boards[0].initialised) { buttons_state = 0xff; }
+
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        if (!boards[b].initialised) { continue; }
+        if (boards[b].keypad_fifo) {
+            fifo_boards |= 1 << b;
+            len[b] = 1;
+        } else {
+            gpio_boards |= 1 << b;
+            len[b] = 4;
+        }
     }
-}
 
-void process_keys(uint32_t now) {
-    for (int i = 0; i < 4; i++) {
-        neokey_key_t* key = &keys[i];
-        uint8_t new_bt_state = buttons_state & key->bt_mask;
-        #if (DEBUG_PROCESS_KEYS)
-            if (i == 0) {
-                if (key->bt_prev_state != new_bt_state) {
-                    printf("process_keys (key=%i): %i != %i, state=%i\n", i, key->bt_prev_state, new_bt_state, key->st_current_state);
-                }
-            }
-        #endif
-        switch (key->st_current_state) {
-            case (ST_RELEASED): {
-                if (new_bt_state == 0) {
-                    key->time = now;
-                    key->st_current_state = ST_PRESSED_DEBOUNCE;
-                    set_key_state(key, KEY_DOWN);
-                }
-            }
-            break;
-            case (ST_PRESSED_DEBOUNCE): {
-                if (new_bt_state != 0) {
-                    key->st_current_state = ST_RELEASED;
-                    set_key_state(key, KEY_UP);
-                } else {
-                    if (now - key->time > KEY_DEBOUNCE_TIME) {
-                        key->st_current_state = ST_PRESSED;
-                        set_key_state(key, KEY_PRESSED);
-                    }
-                }
-            }
-            break;
-            case (ST_PRESSED): {
-                if (new_bt_state != 0) {
-                    key->time = now;
-                    key->st_current_state = ST_RELEASED_DEBOUNCE;
-                    set_key_state(key, KEY_UP);
-                } else {
-                    if (now - key->time > KEY_LONG_PRESS_TIME) {
-                        set_key_state(key, KEY_LONG_PRESSED);
-                        key->st_current_state = ST_LONG_PRESS;
-                    }
-                }
-            }
-            break;
-            case (ST_LONG_PRESS): {
-                if (new_bt_state != 0) {
-                    key->time = now;
-                    key->st_current_state = ST_RELEASED_DEBOUNCE_LONG_PRESS;
-                    set_key_state(key, KEY_UP);
-                }
-            }
-            break;
-            case (ST_RELEASED_DEBOUNCE_LONG_PRESS): {
-                if (new_bt_state == 0) {
-                    key->st_current_state = ST_LONG_PRESS;
-                    set_key_state(key, KEY_DOWN);
+    if (gpio_boards) {
+        gpio_boards = read_boards(gpio_boards, GPIO_BASE, GPIO_BULK, data, len);
+    }
+    if (fifo_boards) {
+        fifo_boards = read_boards(fifo_boards, KEYPAD_BASE, KEYPAD_COUNT, data, len);
+    }
+
+    uint8_t drain_boards = 0;
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        if ((fifo_boards & (1 << b)) && data[b][0] > 0) {
+            len[b] = data[b][0] < KEYPAD_FIFO_SIZE ? data[b][0] : KEYPAD_FIFO_SIZE;
+            drain_boards |= 1 << b;
+        }
+    }
+
+    uint16_t fifo_keys = 0;
+    if (drain_boards) {
+        drain_boards = read_boards(drain_boards, KEYPAD_BASE, KEYPAD_FIFO, data, len);
+
+        // Events are already debounced by the Seesaw; replay each one so that
+        // a press and release that both happened since the last poll are still seen.
+        for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+            if (!(drain_boards & (1 << b))) { continue; }
+            #if (DEBUG_READ_KEYS)
+                printf("read_keys_raw 0x%02x: %i events\n", boards[b].address, len[b]);
+            #endif
+            for (int i = 0; i < len[b]; i++) {
+                uint8_t key = KEYPAD_FIFO_KEY(data[b][i]);
+                if (key < BUTTON_A || key > BUTTON_D) { continue; }
+                uint16_t key_bit = 1 << (b * NEOKEY_KEYS_PER_BOARD + key - BUTTON_A);
+                uint8_t edge = KEYPAD_FIFO_EDGE(data[b][i]);
+                if (edge == KEYPAD_EDGE_RISING || edge == KEYPAD_EDGE_HIGH) {
+                    keys_pressed |= key_bit;
                 } else {
-                    if (now - key->time > KEY_DEBOUNCE_TIME) {
-                        key->st_current_state = ST_RELEASED;
-                        set_key_state(key, KEY_RELEASED);
-                    }
+                    keys_pressed &= ~key_bit;
                 }
+                keys_sample(keys_pressed, now);
             }
-            break;
-            case (ST_RELEASED_DEBOUNCE): {
-                if (new_bt_state == 0) {
-                    key->st_current_state = ST_PRESSED;
-                    set_key_state(key, KEY_DOWN);
-                } else {
-                    if (now - key->time > KEY_DEBOUNCE_TIME) {
-                        key->st_current_state = ST_RELEASED;
-                        set_key_state(key, KEY_RELEASED);
-                    }
-                }
+        }
+    }
+
+    uint16_t present = 0;
+    for (int b = 0; b < NEOKEY_MAX_BOARDS; b++) {
+        uint16_t board_keys = ((1 << NEOKEY_KEYS_PER_BOARD) - 1) << (b * NEOKEY_KEYS_PER_BOARD);
+        if (gpio_boards & (1 << b)) {
+            #if (DEBUG_READ_KEYS)
+                printf("read_keys_raw 0x%02x: [%i, %i, %i, %i]\n", boards[b].address, data[b][0], data[b][1], data[b][2], data[b][3]);
+            #endif
+            uint16_t pressed = ((~data[b][3] & BUTTON_MASK) >> BUTTON_A) << (b * NEOKEY_KEYS_PER_BOARD);
+            keys_pressed = (keys_pressed & ~board_keys) | pressed;
+            if (b == 0) {
+                buttons_state = data[b][3] & 0xf0;
+                for (int i = 0; i < 4; i++) { buttons[i] = data[b][i]; }
             }
-            break;
-            default: break;
+        } else if (b == 0 && boards[b].initialised) {
+            buttons_state = ~((keys_pressed & board_keys) << BUTTON_A) & BUTTON_MASK;
         }
+        if (boards[b].initialised) { present |= board_keys; }
+    }
+
+    // Keys of boards that dropped out read as released. Sampled even when
+    // nothing changed, long press timing depends on it.
+    keys_pressed &= present;
+    keys_sample(keys_pressed, now);
+}
+
+// Key engine: all keys are debounced in parallel, one bit per key, with a
+// vertical counter counting consecutive samples that differ from the
+// debounced state. Every edge goes into the event queue with the time of the sample.
+
+static uint16_t raw_pressed = 0;
+static uint16_t debounced = 0;
+static uint16_t count0 = 0;
+static uint16_t count1 = 0;
+static uint16_t count2 = 0;
+static uint16_t long_pressed = 0;
+static uint32_t pressed_time[NEOKEY_MAX_KEYS];
+
+// Threshold bit planes for debounce sample count, core1 only like the timing below
+static uint16_t threshold0 = 0;
+static uint16_t threshold1 = 0;
+static uint16_t threshold2 = 0;
+static uint32_t long_press_time = KEY_LONG_PRESS_TIME;
+static uint32_t debounce_samples = 1;
+static bool hardware_debounced = false;
+
+// Key timing of the selected profile. keys_configure() on core0 bumps
+// keys_config_requested, core1 takes it before its next sample.
+static volatile uint32_t debounce_time_requested = KEY_DEBOUNCE_TIME;
+static volatile uint32_t long_press_requested = KEY_LONG_PRESS_TIME;
+static volatile uint32_t keys_config_requested = 0;
+static uint32_t keys_config_applied = 0;
+
+// Single producer (core1, keys_sample) / single consumer (core0, get_key_event)
+static key_event_t key_events[KEY_EVENT_QUEUE_SIZE];
+static volatile uint32_t key_events_head = 0;
+static volatile uint32_t key_events_tail = 0;
+uint32_t key_events_dropped = 0;
+
+void keys_configure(uint32_t debounce_time, uint32_t long_press) {
+    debounce_time_requested = debounce_time;
+    long_press_requested = long_press;
+    __dmb();
+    keys_config_requested++;
+}
+
+static void keys_update_thresholds() {
+    // Keypad FIFO edges are debounced by the Seesaw, each one is taken as it comes
+    uint32_t samples = hardware_debounced ? 1 : debounce_samples;
+    threshold0 = (samples & 1) ? 0xFFFF : 0;
+    threshold1 = (samples & 2) ? 0xFFFF : 0;
+    threshold2 = (samples & 4) ? 0xFFFF : 0;
+}
+
+static void keys_apply_config() {
+    uint32_t requested = keys_config_requested;
+    __dmb();
+    uint32_t samples = (debounce_time_requested + KEY_SAMPLE_PERIOD - 1) / KEY_SAMPLE_PERIOD;
+    if (samples < 1) { samples = 1; }
+    if (samples > KEY_DEBOUNCE_MAX_SAMPLES) { samples = KEY_DEBOUNCE_MAX_SAMPLES; }
+    debounce_samples = samples;
+    long_press_time = long_press_requested;
+    keys_config_applied = requested;
+    keys_update_thresholds();
+}
 
-        if (key->bt_prev_state != new_bt_state) {
-            key->bt_prev_state = new_bt_state;
+static void keys_set_hardware_debounce(bool hardware_debounce) {
+    hardware_debounced = hardware_debounce;
+    keys_update_thresholds();
+}
+
+static void push_key_events(uint16_t mask, uint8_t event, uint32_t now) {
+    while (mask) {
+        uint8_t key = __builtin_ctz(mask);
+        mask &= mask - 1;
+
+        uint32_t head = key_events_head;
+        if (head - key_events_tail >= KEY_EVENT_QUEUE_SIZE) {
+            key_events_dropped += 1;
+            continue;
         }
+        key_events[head % KEY_EVENT_QUEUE_SIZE] = (key_event_t){ .time = now, .key = key, .event = event };
+        __dmb();
+        key_events_head = head + 1;
     }
 }
 
-int get_key_state(uint32_t key_num) {
-    if (key_num >= 0 && key_num <= 3) {
-        neokey_key_t* key = &keys[key_num];
-        if (key->has_change) {
-            key->has_change = 0;
-            return key->key_state;
+// pressed - bit per key, 1 when pressed
+void keys_sample(uint16_t pressed, uint32_t now) {
+    if (keys_config_applied != keys_config_requested) {
+        keys_apply_config();
+    }
+    uint32_t head = key_events_head;
+    uint16_t raw_changed = pressed ^ raw_pressed;
+    raw_pressed = pressed;
+
+    uint16_t delta = pressed ^ debounced;
+    uint16_t carry = count0 & count1;
+    count2 = (count2 ^ carry) & delta;
+    count1 = (count1 ^ count0) & delta;
+    count0 = ~count0 & delta;
+
+    uint16_t toggle = delta & ~((count0 ^ threshold0) | (count1 ^ threshold1) | (count2 ^ threshold2));
+    debounced ^= toggle;
+    count0 &= ~toggle;
+    count1 &= ~toggle;
+    count2 &= ~toggle;
+
+    uint16_t now_pressed = toggle & debounced;
+    for (uint16_t mask = now_pressed; mask; mask &= mask - 1) {
+        pressed_time[__builtin_ctz(mask)] = now;
+    }
+    long_pressed &= debounced;
+
+    uint16_t now_long_pressed = 0;
+    for (uint16_t mask = debounced & raw_pressed & ~long_pressed; mask; mask &= mask - 1) {
+        uint8_t key = __builtin_ctz(mask);
+        if (now - pressed_time[key] >= long_press_time) {
+            now_long_pressed |= 1 << key;
         }
     }
-    return -1;
+    long_pressed |= now_long_pressed;
+
+    // Order of events for the same sample
+    const struct { uint16_t mask; uint8_t event; } edges[] = {
+        { raw_changed & pressed,  KEY_DOWN },
+        { now_pressed,            KEY_PRESSED },
+        { now_long_pressed,       KEY_LONG_PRESSED },
+        { raw_changed & ~pressed, KEY_UP },
+        { toggle & ~debounced,    KEY_RELEASED },
+    };
+    for (int i = 0; i < 5; i++) {
+        push_key_events(edges[i].mask, edges[i].event, now);
+    }
+    if (key_events_head != head) { scheduler_wake(SCHEDULER_WAKE_KEYS); }
+}
+
+bool get_key_event(key_event_t* event) {
+    uint32_t tail = key_events_tail;
+    if (tail == key_events_head) { return false; }
+    __dmb();
+    *event = key_events[tail % KEY_EVENT_QUEUE_SIZE];
+    key_events_tail = tail + 1;
+    return true;
 }
@@ -4,11 +4,37 @@
 
 #define NEOKEY_I2C_ADDRESS 0x30
 
+// Chained Neokey 1x4 boards, address set with the A0-A3 jumpers (0x30 - 0x3F).
+// Keys and LEDs are numbered across boards in this order, NEOKEY_KEYS_PER_BOARD each.
+// Boards that don't answer at init are skipped.
+#define NEOKEY_MAX_BOARDS 4
+#define NEOKEY_I2C_ADDRESSES { NEOKEY_I2C_ADDRESS, 0x31, 0x32, 0x33 }
+#define NEOKEY_KEYS_PER_BOARD 4
+#define NEOKEY_MAX_KEYS (NEOKEY_MAX_BOARDS * NEOKEY_KEYS_PER_BOARD)
+#define NEOKEY_LED_BUF_SIZE (NEOKEY_KEYS_PER_BOARD * 3)
+#define NEOKEY_LEDS_SIZE (NEOKEY_MAX_BOARDS * NEOKEY_LED_BUF_SIZE)
+
+// Keys on a board are wired right to left - maps key (or LED) number
+// from the driver to position on the wheel and back
+#define NEOKEY_KEY_NO(key) (((key) & ~(NEOKEY_KEYS_PER_BOARD - 1)) | (NEOKEY_KEYS_PER_BOARD - 1 - ((key) & (NEOKEY_KEYS_PER_BOARD - 1))))
+
+// LED buffers written per write_leds() call, bounds bus time with many boards
+#define NEOKEY_LED_WRITES_PER_CALL 2
+
+// Seesaw needs time to prepare a read after the register is selected
+#define NEOKEY_READ_DELAY_US 500
+
+// A board that fails is re-initialised in the background, retrying with
+// exponential backoff. After the software reset the Seesaw needs time to boot.
+#define NEOKEY_RECOVERY_BACKOFF_MIN 100
+#define NEOKEY_RECOVERY_BACKOFF_MAX 5000
+#define NEOKEY_RESET_TIME 500
+
 #define BUTTON_A 4
 #define BUTTON_B 5
 #define BUTTON_C 6
 #define BUTTON_D 7
-#define BUTTON_MASK (1 << BUTTON_A) | (1 << BUTTON_B) | (1 << BUTTON_C) | (1 << BUTTON_D)
+#define BUTTON_MASK ((1 << BUTTON_A) | (1 << BUTTON_B) | (1 << BUTTON_C) | (1 << BUTTON_D))
 
 
 #define STATUS_BASE 0x00
@@ -32,6 +58,26 @@
 #define GPIO_PULLENSET 0x0B
 #define GPIO_PULLENCLR 0x0C
 
+#define KEYPAD_BASE 0x10
+#define KEYPAD_STATUS 0x00
+#define KEYPAD_EVENT 0x01
+#define KEYPAD_INTENSET 0x02
+#define KEYPAD_INTENCLR 0x03
+#define KEYPAD_COUNT 0x04
+#define KEYPAD_FIFO 0x10
+
+#define KEYPAD_EDGE_HIGH 0
+#define KEYPAD_EDGE_LOW 1
+#define KEYPAD_EDGE_FALLING 2
+#define KEYPAD_EDGE_RISING 3
+
+// KEYPAD_EVENT value: bit 0 enable, bits 1-4 one bit per edge
+#define KEYPAD_EVENT_ENABLE(edge) ((1 << ((edge) + 1)) | 1)
+// KEYPAD_FIFO entry: bits 0-1 edge, bits 2-7 key number
+#define KEYPAD_FIFO_EDGE(e) ((e) & 0x03)
+#define KEYPAD_FIFO_KEY(e) ((e) >> 2)
+#define KEYPAD_FIFO_SIZE 16
+
 #define NEOPIXEL_BASE 0x0E
 #define NEOPIXEL_STATUS 0x00
 #define NEOPIXEL_PIN 0x01
@@ -40,34 +86,30 @@
 #define NEOPIXEL_BUF 0x04
 #define NEOPIXEL_SHOW 0x05
 
+// Defaults for profiles that don't set their own timings
 #define KEY_DEBOUNCE_TIME 150
 #define KEY_LONG_PRESS_TIME 750
 
+// read_keys_raw() runs every 4th control cycle
+#define KEY_SAMPLE_PERIOD 40
+// Debounce vertical counter is 3 bits deep
+#define KEY_DEBOUNCE_MAX_SAMPLES 7
+
+#define KEY_EVENT_QUEUE_SIZE 32
+
 enum {
-    KEY_DOWN,
-    KEY_RELEASED,
-    KEY_UP,
-    KEY_PRESSED,
+    KEY_DOWN,           // raw press, not debounced yet
+    KEY_RELEASED,       // debounced release
+    KEY_UP,             // raw release, not debounced yet
+    KEY_PRESSED,        // debounced press
     KEY_LONG_PRESSED,
 };
 
 typedef struct TU_ATTR_PACKED
 {
   uint32_t time;
-  uint8_t bt_mask;
-  uint8_t bt_prev_state;
-  uint8_t st_current_state;
-  uint8_t has_change;
-  int key_state;
-} neokey_key_t;
-
-enum {
-  ST_RELEASED = 1,
-  ST_PRESSED_DEBOUNCE,
-  ST_PRESSED,
-  ST_LONG_PRESS,
-  ST_RELEASED_DEBOUNCE,
-  ST_RELEASED_DEBOUNCE_LONG_PRESS
-};
+  uint8_t key;
+  uint8_t event;
+} key_event_t;
 
 #endif /* NEOKEY_H__ */
@@ -84,3 +84,9 @@ float process_pid(float error) {
 
     return output;
 }
+
+void get_pid_terms(float* p_out, float* i_out, float* d_out) {
+    *p_out = p * kp * kg;
+    *i_out = i * ki * kg;
+    *d_out = d * kd * kg;
+}
@@ -7,10 +7,76 @@ typedef struct TU_ATTR_PACKED
     int16_t  value;
 } key_action_t;
 
+enum {
+    MOUSE_LEFT_BUTTON = 0,
+    MOUSE_RIGHT_BUTTON,
+    MOUSE_MIDDLE_BUTTON,
+    MOUSE_WHEEL_X,
+    MOUSE_WHEEL_Y,
+};
+
+enum {
+    JOYSTICK_AXIS_0 = 0,
+    JOYSTICK_AXIS_1,
+    JOYSTICK_AXIS_2,
+};
+
+// Key actions (keys[], gestures):
+//   REPORT_ID_KEYBOARD - value keycode, sub_type modifiers
+//   REPORT_ID_MOUSE    - sub_type MOUSE_*_BUTTON
+//   REPORT_ID_CONSUMER - value usage
+//   REPORT_ID_JOYSTICK - value button number
+// Wheel actions (wheel_main, wheel_alt), per detent:
+//   REPORT_ID_MOUSE    - sub_type MOUSE_WHEEL_Y or MOUSE_WHEEL_X, value steps per detent (0 for 1)
+//   REPORT_ID_KEYBOARD - value low byte keycode clockwise, high byte anticlockwise, sub_type modifiers
+//   REPORT_ID_JOYSTICK or none - absolute angle on axis 'value'
+
+enum {
+    GESTURE_NONE = 0,
+    GESTURE_DOUBLE_TAP,     // key_a tapped twice within GESTURE_DOUBLE_TAP_TIME
+    GESTURE_HOLD,           // key_a held for the long press time, action held until release
+    GESTURE_CHORD,          // key_a and key_b pressed within GESTURE_CHORD_TIME of each other
+    GESTURE_WHEEL_ALT,      // wheel turned while key_a held sends wheel_alt, action not used
+};
+
+typedef struct TU_ATTR_PACKED
+{
+    uint8_t      type;
+    uint8_t      key_a;
+    uint8_t      key_b;
+    uint8_t      padding;
+    key_action_t action;
+} gesture_t;
+
+#define PROFILE_GESTURE_COUNT 8
+
+// Haptic effects, summed with the detents into the tension every control cycle.
+// Angles in degrees 0..359 on the wheel (from the unit's zero, see calibration.h), strength in tension percent.
+enum {
+    EFFECT_NONE = 0,
+    EFFECT_END_STOPS,       // wheel kept between 'start' and 'end' clockwise
+    EFFECT_SPRING,          // pulls towards 'start', full strength 'end' degrees away (0 for 180)
+    EFFECT_FRICTION,        // viscous, full strength at EFFECT_FRICTION_VELOCITY
+    EFFECT_BARRIER,         // bump felt once when passing 'start', 'end' degrees wide
+};
+
+typedef struct TU_ATTR_PACKED
+{
+    uint8_t  type;
+    uint8_t  padding;
+    int16_t  start;
+    int16_t  end;
+    int16_t  strength;
+} effect_t;
+
+#define PROFILE_EFFECT_COUNT 4
+
+// Actions for keys across all Neokey boards, indexed by key number (NEOKEY_KEY_NO)
+#define PROFILE_KEY_COUNT 16
+
 typedef struct TU_ATTR_PACKED
 {
     uint32_t     direction;
-    int32_t      zero;
     uint32_t     dividers;
     float        expo;
     float        gain_factor;
@@ -19,8 +85,43 @@ typedef struct TU_ATTR_PACKED
     uint8_t      padding;
     key_action_t wheel_main;
     key_action_t wheel_alt;
-    key_action_t key1;
-    key_action_t key2;
-    key_action_t key3;
+    key_action_t keys[PROFILE_KEY_COUNT];
+    uint16_t     key_debounce_time;   // ms, 0 for KEY_DEBOUNCE_TIME
+    uint16_t     key_long_press_time; // ms, 0 for KEY_LONG_PRESS_TIME
+    gesture_t    gestures[PROFILE_GESTURE_COUNT];
+    effect_t     effects[PROFILE_EFFECT_COUNT];
+    uint16_t     pwm_frequency;       // Hz, 0 for PWM_FREQUENCY
+    uint8_t      sensor_filter;       // AS5600 CONF, see sensor.h
+    uint8_t      sensor_fast_threshold;
+    uint8_t      sensor_hysteresis;
+    uint8_t      sensor_oversample;   // reads per cycle, median taken; 0 or 1 for one
+    uint16_t     flywheel_inertia;    // ms to catch up with the hand, 0 for detents (see flywheel.h)
+    uint16_t     flywheel_friction;   // degrees/s lost per second while coasting
+    uint16_t     accel_gain;          // percent at accel_high, 0 or 100 for none (see accel.h)
+    uint16_t     accel_low;           // degrees/s
+    uint16_t     accel_high;          // degrees/s
+    uint16_t     accel_curve;         // exponent x10, 0 for linear
 } profile_t;
 
+
+
+#define PROFILE_COUNT 9
+
+// PROFILES.BIN - all profiles packed in one image:
+// profiles_bin_header_t followed by PROFILE_COUNT profile_t entries.
+// Bump PROFILES_BIN_VERSION whenever profile_t layout changes
+// and keep python/profiles_bin.py in sync.
+#define PROFILES_BIN_MAGIC   0x42505745 // "EWPB"
+#define PROFILES_BIN_VERSION 10
+
+typedef struct TU_ATTR_PACKED
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;
+    uint16_t profile_size;
+    uint16_t profile_count;
+    uint32_t crc32;          // CRC-32 of the profile entries
+} profiles_bin_header_t;
+
+#define PROFILES_BIN_SIZE (sizeof(profiles_bin_header_t) + PROFILE_COUNT * sizeof(profile_t))
@@ -0,0 +1,143 @@
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "scheduler.h"
+#include "log.h"
+
+typedef void (*scheduler_task_fn)();
+
+typedef struct {
+    scheduler_task_fn fn;
+    uint8_t priority;
+    uint8_t wake_mask;
+    bool enabled;
+    bool woken;
+    uint32_t period_us;             // 0 - runs on wakeups only
+    uint32_t next_run_us;
+    uint32_t runs;
+    uint32_t busy_us;
+    uint32_t longest_us;
+} scheduler_task_t;
+
+static scheduler_task_t tasks[SCHEDULER_MAX_TASKS];
+static int task_count = 0;
+
+// One flag per source, core1 raises them without a read-modify-write
+static volatile bool wake_pending[SCHEDULER_WAKE_COUNT];
+
+static uint32_t idle_us = 0;
+static uint32_t sleeps = 0;
+static uint32_t stats_started_at = 0;
+
+int scheduler_add_task(scheduler_task_fn fn, uint8_t priority, uint32_t period_ms, uint8_t wake_mask, bool enabled) {
+    if (task_count >= SCHEDULER_MAX_TASKS) { return -1; }
+    tasks[task_count] = (scheduler_task_t){
+        .fn = fn, .priority = priority, .wake_mask = wake_mask, .enabled = enabled,
+        .period_us = period_ms * 1000, .next_run_us = time_us_32() + period_ms * 1000,
+    };
+    return task_count++;
+}
+
+void scheduler_enable(int task, bool enable) {
+    if (task < 0 || task >= task_count) { return; }
+    tasks[task].enabled = enable;
+    tasks[task].next_run_us = time_us_32() + tasks[task].period_us;
+}
+
+// Called by the task itself it sets the delay to its next run, otherwise it takes effect after that
+void scheduler_set_period(int task, uint32_t period_ms) {
+    if (task < 0 || task >= task_count) { return; }
+    tasks[task].period_us = period_ms * 1000;
+}
+
+// Callable from either core, not from interrupt handlers
+void scheduler_wake(uint8_t source) {
+    wake_pending[source] = true;
+    __sev();
+}
+
+static void collect_wakeups() {
+    uint8_t sources = 0;
+    if (tud_task_event_ready()) { sources |= SCHEDULER_WAKE(SCHEDULER_WAKE_USB); }
+    for (uint8_t source = 0; source < SCHEDULER_WAKE_COUNT; source++) {
+        if (wake_pending[source]) {
+            wake_pending[source] = false;
+            sources |= SCHEDULER_WAKE(source);
+        }
+    }
+    if (!sources) { return; }
+    for (int i = 0; i < task_count; i++) {
+        if (tasks[i].wake_mask & sources) { tasks[i].woken = true; }
+    }
+}
+
+static scheduler_task_t* next_ready(uint32_t now) {
+    scheduler_task_t* next = NULL;
+    for (int i = 0; i < task_count; i++) {
+        scheduler_task_t* task = &tasks[i];
+        if (!task->enabled) { continue; }
+        bool due = task->period_us != 0 && (int32_t)(now - task->next_run_us) >= 0;
+        if ((task->woken || due) && (next == NULL || task->priority < next->priority)) {
+            next = task;
+        }
+    }
+    return next;
+}
+
+static void run_task(scheduler_task_t* task, uint32_t now) {
+    task->woken = false;
+    task->fn();
+    task->next_run_us = now + task->period_us;
+    uint32_t took = time_us_32() - now;
+    task->runs += 1;
+    task->busy_us += took;
+    if (took > task->longest_us) { task->longest_us = took; }
+}
+
+// Sleeps until the earliest deadline, or an event
+static void idle(uint32_t now) {
+    uint32_t sleep_us = SCHEDULER_MAX_SLEEP_US;
+    for (int i = 0; i < task_count; i++) {
+        if (!tasks[i].enabled || tasks[i].period_us == 0) { continue; }
+        int32_t until = tasks[i].next_run_us - now;
+        if (until < (int32_t)sleep_us) { sleep_us = until > 0 ? until : 0; }
+    }
+    if (sleep_us == 0) { return; }
+
+    best_effort_wfe_or_timeout(delayed_by_us(get_absolute_time(), sleep_us));
+    idle_us += time_us_32() - now;
+    sleeps += 1;
+}
+
+static void report_stats(uint32_t now) {
+    uint32_t period_us = now - stats_started_at;
+    if (period_us < SCHEDULER_STATS_PERIOD_MS * 1000) { return; }
+
+    for (int i = 0; i < task_count; i++) {
+        scheduler_task_t* task = &tasks[i];
+        LOG(LOG_SCHEDULER_TASK, i, task->runs,
+            (uint32_t)((uint64_t)task->busy_us * 1000 / period_us), task->longest_us);
+        task->runs = 0;
+        task->busy_us = 0;
+        task->longest_us = 0;
+    }
+    LOG(LOG_SCHEDULER_IDLE, (uint32_t)((uint64_t)idle_us * 1000 / period_us), sleeps);
+    idle_us = 0;
+    sleeps = 0;
+    stats_started_at = now;
+}
+
+// Never returns
+void scheduler_run() {
+    stats_started_at = time_us_32();
+    while (true) {
+        collect_wakeups();
+        uint32_t now = time_us_32();
+        scheduler_task_t* task = next_ready(now);
+        if (task != NULL) {
+            run_task(task, now);
+        } else {
+            idle(now);
+        }
+        report_stats(time_us_32());
+    }
+}
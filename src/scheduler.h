@@ -0,0 +1,33 @@
+#ifndef SCHEDULER_H__
+#define SCHEDULER_H__
+
+// Cooperative scheduler for the core0 main loop. A task runs when its period
+// has passed or when one of its wakeup sources was raised, highest priority
+// first. When nothing is due core0 sleeps in WFE until the next deadline or an
+// event - any interrupt (USB) or a SEV from core1.
+
+enum {
+    SCHEDULER_WAKE_USB = 0,         // tud_task() has events queued by the USB interrupt
+    SCHEDULER_WAKE_KEYS,            // core1 queued key events
+    SCHEDULER_WAKE_CORE1,           // core1 finished a control cycle
+    SCHEDULER_WAKE_COUNT,
+};
+
+#define SCHEDULER_WAKE(source) (1 << (source))
+
+// Lower runs first
+enum {
+    SCHEDULER_PRIORITY_USB = 0,
+    SCHEDULER_PRIORITY_INPUT,
+    SCHEDULER_PRIORITY_OUTPUT,
+    SCHEDULER_PRIORITY_BACKGROUND,
+};
+
+#define SCHEDULER_MAX_TASKS 16
+
+// Longest WFE sleep, bounds the cost of a missed event
+#define SCHEDULER_MAX_SLEEP_US 10000
+
+#define SCHEDULER_STATS_PERIOD_MS 10000
+
+#endif /* SCHEDULER_H__ */
@@ -0,0 +1,60 @@
+#ifndef SENSOR_H__
+#define SENSOR_H__
+
+#include "common/tusb_common.h"
+
+// Every AS5600 sample carries a status (SENSOR_*). Only valid samples update
+// the angle and the PID; on an invalid one the last tension is held for
+// SENSOR_HOLD_CYCLES and then the motor coasts until the sensor is back.
+// A weak or strong magnet still gives an angle, it is only flagged and counted.
+
+// AS5600 STATUS register bits
+#define AS5600_STATUS_MH 0x08       // magnet too strong
+#define AS5600_STATUS_ML 0x10       // magnet too weak
+#define AS5600_STATUS_MD 0x20       // magnet detected
+
+// AS5600 registers read every cycle: STATUS and RAW ANGLE, the 12 bit angle
+// before the ZPOS/MPOS scaling of ANGLE - calibration and the median work on it
+#define AS5600_REG_STATUS 0x0B      // STATUS, RAW ANGLE (2)
+
+// CONF register, set from the profile (sensor_filter, sensor_fast_threshold,
+// sensor_hysteresis - 0 is the chip default) when core1 starts and on every
+// profile change. Power mode is always on.
+//   filter         - slow filter 16x, 8x, 4x, 2x: less noise or less delay
+//   fast_threshold - step in LSBs that switches to the fast filter: off, 6, 7, 9, 18, 21, 24, 10
+//   hysteresis     - output hysteresis off, 1, 2, 3 LSBs
+#define AS5600_REG_CONF 0x07
+#define AS5600_CONF(filter, fast_threshold, hysteresis) \
+    ((((fast_threshold) & 0x7) << 10) | (((filter) & 0x3) << 8) | (((hysteresis) & 0x3) << 2))
+
+// Output delay of the 16x slow filter (half its settling time), halves with every filter step
+#define AS5600_FILTER_DELAY_US 1100
+
+// With sensor_oversample above 1 the angle is the median of that many reads in
+// a burst, taken at the middle of the burst
+#define SENSOR_MAX_OVERSAMPLE 5
+
+enum {
+    SENSOR_VALID = 0x01,
+    SENSOR_I2C_ERROR = 0x02,
+    SENSOR_MAGNET_MISSING = 0x04,
+    SENSOR_MAGNET_WEAK = 0x08,
+    SENSOR_MAGNET_STRONG = 0x10,
+    SENSOR_COASTING = 0x20,         // motor off after SENSOR_HOLD_CYCLES invalid samples
+};
+
+#define SENSOR_HOLD_CYCLES 3
+
+// Counters since start, in telemetry_t and logged every SENSOR_STATS_PERIOD_MS when changed
+typedef struct TU_ATTR_PACKED
+{
+    uint32_t i2c_errors;
+    uint32_t magnet_missing;
+    uint32_t magnet_weak;
+    uint32_t magnet_strong;
+    uint32_t coasts;                // times the motor was let go
+} sensor_faults_t;
+
+#define SENSOR_STATS_PERIOD_MS 10000
+
+#endif /* SENSOR_H__ */
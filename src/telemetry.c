@@ -0,0 +1,78 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "frame.h"
+#include "telemetry.h"
+
+extern bool frame_send(uint8_t type, const void* payload, uint8_t len);
+
+#define TELEMETRY_STREAM_SIZE 64 // samples, power of 2 - 64 ms at 1 kHz
+
+// Sequence lock - odd sequence means core1 is in the middle of an update
+static telemetry_t telemetry;
+static volatile uint32_t telemetry_sequence = 0;
+
+// Stream of every sample from core1 to core0 - single producer / single consumer.
+// When core0 can't keep up samples are dropped (the host sees gaps in 'cycle').
+static telemetry_t stream[TELEMETRY_STREAM_SIZE];
+static volatile uint32_t stream_head = 0;
+static volatile uint32_t stream_tail = 0;
+static volatile bool stream_enabled = false;
+uint32_t telemetry_stream_dropped = 0;
+
+void telemetry_publish(const telemetry_t* sample) {
+    telemetry_sequence += 1;
+    __dmb();
+    memcpy(&telemetry, sample, sizeof(telemetry_t));
+    __dmb();
+    telemetry_sequence += 1;
+
+    if (stream_enabled) {
+        uint32_t head = stream_head;
+        if (head - stream_tail >= TELEMETRY_STREAM_SIZE) {
+            telemetry_stream_dropped += 1;
+        } else {
+            memcpy(&stream[head % TELEMETRY_STREAM_SIZE], sample, sizeof(telemetry_t));
+            __dmb();
+            stream_head = head + 1;
+        }
+    }
+}
+
+bool telemetry_snapshot(telemetry_t* sample) {
+    for (int retry = 0; retry < 4; retry++) {
+        uint32_t sequence = telemetry_sequence;
+        if (sequence & 1) { continue; }
+        __dmb();
+        memcpy(sample, &telemetry, sizeof(telemetry_t));
+        __dmb();
+        if (sequence == telemetry_sequence) { return true; }
+    }
+    return false;
+}
+
+void telemetry_stream_enable(bool enable) {
+    stream_enabled = enable;
+}
+
+// Called from core0 main loop - sends queued samples as far as the CDC buffer allows
+void telemetry_stream_task() {
+    bool sent = false;
+
+    if (stream_enabled && !tud_cdc_connected()) {
+        stream_enabled = false;
+    }
+
+    while (stream_tail != stream_head) {
+        __dmb();
+        if (!frame_send(FRAME_TYPE_TELEMETRY, &stream[stream_tail % TELEMETRY_STREAM_SIZE], sizeof(telemetry_t))) {
+            break;
+        }
+        stream_tail += 1;
+        sent = true;
+    }
+
+    if (sent) {
+        tud_cdc_write_flush();
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef TELEMETRY_H__
+#define TELEMETRY_H__
+
+#include "common/tusb_common.h"
+#include "sensor.h"
+
+// Snapshot of the control loop, published by core1 every cycle
+// and read on core0 with telemetry_snapshot().
+
+typedef struct TU_ATTR_PACKED
+{
+    uint32_t time_us;
+    uint32_t cycle;
+    uint16_t raw_angle;        // AS5600 raw counts, 0-4095
+    int16_t  angle;            // degrees, zero offset applied
+    float    velocity;         // degrees/s
+    float    error;
+    float    p;                // weighted PID terms
+    float    i;
+    float    d;
+    float    tension;          // duty, -100 to 100
+    uint32_t overrun_millis;
+    uint8_t  selected_profile;
+    uint8_t  buttons_state;
+    float    current;          // motor mA, 0 without CURRENT_LOOP
+    uint8_t  sensor_status;    // SENSOR_* of this cycle's sample
+    sensor_faults_t sensor_faults;
+} telemetry_t;
+
+#endif /* TELEMETRY_H__ */
@@ -82,7 +82,8 @@
 
 #define CFG_TUD_HID             (1)
 
-#define CFG_TUD_HID_BUFSIZE     (16)
+// Large enough for the profile feature report
+#define CFG_TUD_HID_BUFSIZE     (256)
 
 #define CFG_HID_KEYBOARD        (1)
 #define CFG_HID_MOUSE           (1)
@@ -97,9 +98,12 @@
 #define REPORT_ID_GAMEPAD       (4)
 #define REPORT_ID_CONSUMER      (5)
 #define REPORT_ID_JOYSTICK      (6)
+#define REPORT_ID_CONFIG        (7)
+#define REPORT_ID_PROFILE       (8)
+#define REPORT_ID_TELEMETRY     (9)
 
 #define REPORT_ID_MIN           (1)
-#define REPORT_ID_MAX           (6)
+#define REPORT_ID_MAX           (9)
 
 // .--------------------------------------------------------------------------.
 // |    Does not support MIDI Device (MIDI)                                   |
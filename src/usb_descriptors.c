@@ -34,6 +34,8 @@
 #include "tusb.h"
 #include "pico/unique_id.h"
 #include "pico/binary_info.h"
+#include "profile.h"
+#include "telemetry.h"
 
 // ****************************************************************************
 // *                                                                          *
@@ -212,6 +214,35 @@ static const tusb_desc_device_t usbd_desc_device = {
     HID_INPUT        ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
   HID_COLLECTION_END \
 
+// Vendor defined feature reports for configuration and telemetry:
+// CONFIG    - [selected profile, profile cursor]
+// PROFILE   - [profile index, profile_t]; get returns the profile at the cursor
+// TELEMETRY - telemetry_t (get only)
+#define CONFIG_REPORT_SIZE      (2)
+#define PROFILE_REPORT_SIZE     (1 + sizeof(profile_t))
+#define TELEMETRY_REPORT_SIZE   (sizeof(telemetry_t))
+
+_Static_assert(PROFILE_REPORT_SIZE + 1 <= CFG_TUD_HID_BUFSIZE, "CFG_TUD_HID_BUFSIZE too small for profile report");
+_Static_assert(TELEMETRY_REPORT_SIZE + 1 <= CFG_TUD_HID_BUFSIZE, "CFG_TUD_HID_BUFSIZE too small for telemetry report");
+
+#define TUD_HID_REPORT_DESC_VENDOR_FEATURE(report_id, usage, size) \
+    HID_REPORT_ID    ( report_id                              ) \
+    HID_USAGE        ( usage                                  ) ,\
+    HID_LOGICAL_MIN  ( 0x00                                   ) ,\
+    HID_LOGICAL_MAX_N( 0xFF, 2                                ) ,\
+    HID_REPORT_SIZE  ( 8                                      ) ,\
+    HID_REPORT_COUNT_N( size, 2                               ) ,\
+    HID_FEATURE      ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE ) ,\
+
+#define TUD_HID_REPORT_DESC_CONFIG() \
+  HID_USAGE_PAGE_N ( HID_USAGE_PAGE_VENDOR, 2 )                 ,\
+  HID_USAGE        ( 0x01                     )                 ,\
+  HID_COLLECTION   ( HID_COLLECTION_APPLICATION )               ,\
+    TUD_HID_REPORT_DESC_VENDOR_FEATURE(REPORT_ID_CONFIG,    0x02, CONFIG_REPORT_SIZE) \
+    TUD_HID_REPORT_DESC_VENDOR_FEATURE(REPORT_ID_PROFILE,   0x03, PROFILE_REPORT_SIZE) \
+    TUD_HID_REPORT_DESC_VENDOR_FEATURE(REPORT_ID_TELEMETRY, 0x04, TELEMETRY_REPORT_SIZE) \
+  HID_COLLECTION_END \
+
 #define EPNUM_HID               (0x83)
 
 #define USBD_HID_BUFSIZE        (16)
@@ -226,11 +257,12 @@ static const tusb_desc_device_t usbd_desc_device = {
 
 static const uint8_t desc_hid_report[] =
 {
-    // TUD_HID_REPORT_DESC_KEYBOARD  (HID_REPORT_ID(REPORT_ID_KEYBOARD)),
-    // TUD_HID_REPORT_DESC_MOUSE     (HID_REPORT_ID(REPORT_ID_MOUSE)),
+    TUD_HID_REPORT_DESC_KEYBOARD   (HID_REPORT_ID(REPORT_ID_KEYBOARD)),
+    TUD_HID_REPORT_DESC_MOUSE      (HID_REPORT_ID(REPORT_ID_MOUSE)),
     // TUD_HID_REPORT_DESC_GAMEPAD   (HID_REPORT_ID(REPORT_ID_GAMEPAD)),
-    // TUD_HID_REPORT_DESC_CONSUMER  (HID_REPORT_ID(REPORT_ID_CONSUMER))
+    TUD_HID_REPORT_DESC_CONSUMER   (HID_REPORT_ID(REPORT_ID_CONSUMER)),
     TUD_HID_REPORT_DESC_JOYSTICK   (HID_REPORT_ID(REPORT_ID_JOYSTICK)),
+    TUD_HID_REPORT_DESC_CONFIG     (),
 };
 
 // ****************************************************************************